@@ -7,15 +7,53 @@
  *
  * @brief  Cross-platform declaration "i2c" bsp module.
  *
+ * Transactions are queued and executed one after the other by the TWIM interrupt, the caller
+ * doesn't wait for the bus: each transaction has a completion callback, called from the
+ * interrupt handler. Several drivers can submit transactions at the same time.
+ *
+ * db_i2c_read_regs and db_i2c_write_regs are blocking wrappers, they can't be called from
+ * interrupt context (completion callbacks included).
+ *
  * @author Alexandre Abadie <alexandre.abadie@inria.fr>
  *
  * @copyright Inria, 2022
  */
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <nrf.h>
 #include "gpio.h"
 
+//=========================== defines ==========================================
+
+#define DB_I2C_WRITE_MAX_LENGTH (31U)  ///< Max number of bytes written in a transaction, register address excluded
+
+typedef enum {
+    DB_I2C_STATUS_PENDING,       ///< Transaction queued or running
+    DB_I2C_STATUS_OK,            ///< Transaction completed
+    DB_I2C_STATUS_ADDRESS_NACK,  ///< The device didn't acknowledge its address
+    DB_I2C_STATUS_DATA_NACK,     ///< The device didn't acknowledge a data byte
+} db_i2c_status_t;
+
+typedef struct db_i2c_transaction db_i2c_transaction_t;
+
+typedef void (*db_i2c_cb_t)(db_i2c_transaction_t *transaction);  ///< Completion callback, called from the TWIM interrupt
+
+/// Transaction, the storage is provided by the user and must not be modified until the transaction completes
+struct db_i2c_transaction {
+    db_i2c_transaction_t    *next;      ///< Next queued transaction (internal)
+    uint8_t                  addr;      ///< Address of the device on the I2C bus
+    uint8_t                  reg;       ///< Address of the first register to read or write
+    bool                     write;     ///< Write the data to the registers instead of reading them
+    void                    *data;      ///< Bytes read (count * length bytes) or to write (length bytes)
+    uint8_t                  length;    ///< Number of bytes read or written
+    uint8_t                  count;     ///< Reads only, number of times the registers are read in a row (0 and 1 are once)
+    db_i2c_cb_t              callback;  ///< Function called when the transaction completes, can be NULL
+    volatile db_i2c_status_t status;    ///< Status of the transaction, updated before the callback is called
+};
+
+//=========================== prototypes =======================================
+
 /**
  * @brief Initialize the I2C peripheral
  *
@@ -30,12 +68,28 @@ void db_i2c_init(const gpio_t *scl, const gpio_t *sda);
 void db_i2c_begin(void);
 
 /**
- * @brief End transmission on I2C
+ * @brief End transmission on I2C, waits for the queued transactions to complete
  */
 void db_i2c_end(void);
 
 /**
- * @brief Read bytes from one register
+ * @brief Queue a transaction, it starts right away if the bus is idle
+ *
+ * Can be called from interrupt and thread contexts. Repeated reads use the TWIM RXD list mode:
+ * each read writes the next item of the data buffer, and the TWIM interrupt restarts the next read
+ * (register address write then read) until all of them are done.
+ *
+ * @param[in]   transaction Pointer to the transaction
+ */
+void db_i2c_submit(db_i2c_transaction_t *transaction);
+
+/**
+ * @brief Whether transactions are queued or running
+ */
+bool db_i2c_busy(void);
+
+/**
+ * @brief Read bytes from one register (blocking)
  *
  * @param[in]   addr    Address of the device on the I2C bus
  * @param[in]   reg     Address of the register to read
@@ -45,7 +99,7 @@ void db_i2c_end(void);
 void db_i2c_read_regs(uint8_t addr, uint8_t reg, void *data, size_t len);
 
 /**
- * @brief Write bytes to register
+ * @brief Write bytes to register (blocking)
  *
  * @param[in]   addr    Address of the device on the I2C bus
  * @param[in]   reg     Address of the register to write
@@ -7,6 +7,13 @@
  *
  * @brief  Declaration for "ipc" bsp module.
  *
+ * The application and network cores of the nRF5340 exchange messages through 2 single
+ * producer/single consumer rings located in shared RAM, one per direction. The IPC peripheral is
+ * only used as a doorbell to notify the other core that messages are available.
+ *
+ * Each request has an identifier that is copied in its acknowledgment, several requests can be
+ * queued without waiting and a callback is called when each one completes.
+ *
  * @author Alexandre Abadie <alexandre.abadie@inria.fr>
  *
  * @copyright Inria, 2023
@@ -14,18 +21,20 @@
 
 #include <nrf.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "radio.h"
 #include "timer_hf.h"
 
-#if defined(NRF_APPLICATION)
-#define NRF_MUTEX NRF_MUTEX_NS
-#elif defined(NRF_NETWORK)
-#define NRF_MUTEX NRF_APPMUTEX_NS
-#endif
+//=========================== defines ==========================================
 
 #define IPC_IRQ_PRIORITY (1)
 
+#define IPC_RING_SLOTS      (8U)     ///< Number of messages in each ring (must be a power of 2)
+#define IPC_SHARED_RAM_SIZE (8192U)  ///< Size of the RAM region shared between the cores
+#define IPC_PENDING_MAX     (16U)    ///< Max number of requests waiting for their acknowledgment (must be a power of 2)
+#define IPC_ENTROPY_SIZE    (64U)    ///< Number of random bytes in the entropy pool (must be a power of 2)
+
 typedef enum {
     DB_IPC_NONE,              ///< Sorry, but nothing
     DB_IPC_NET_READY_ACK,     ///< Network core is ready
@@ -45,54 +54,145 @@ typedef enum {
     DB_IPC_RADIO_TX_ACK,      ///< Acknowledment for radio tx
     DB_IPC_RNG_INIT_REQ,      ///< Request for rng init
     DB_IPC_RNG_INIT_ACK,      ///< Acknowledment for rng init
-    DB_IPC_RNG_READ_REQ,      ///< Request for rng read
-    DB_IPC_RNG_READ_ACK,      ///< Acknowledment for rng read
+    DB_IPC_RADIO_TX_RX_REQ,   ///< Request for radio rx disable, tx and rx enable
+    DB_IPC_RADIO_TX_RX_ACK,   ///< Acknowledment for radio rx disable, tx and rx enable
+    DB_IPC_RADIO_RX,          ///< Radio pdu received by the network core
+    DB_IPC_EVENT_COUNT,       ///< Number of IPC events
 } ipc_event_type_t;
 
 typedef enum {
-    DB_IPC_CHAN_REQ      = 0,  ///< Channel used for request events
-    DB_IPC_CHAN_ACK      = 1,  ///< Channel used for acknownlegment events
-    DB_IPC_CHAN_RADIO_RX = 2,  ///< Channel used for radio RX events
+    DB_IPC_CHAN_APP_TO_NET = 0,  ///< Doorbell of the application to network core ring
+    DB_IPC_CHAN_NET_TO_APP = 1,  ///< Doorbell of the network to application core ring
 } ipc_channels_t;
 
 typedef struct __attribute__((packed)) {
     uint8_t length;             ///< Length of the pdu in bytes
+    int8_t  rssi;               ///< RSSI of a received pdu, in dBm
     uint8_t buffer[UINT8_MAX];  ///< Buffer containing the pdu data
 } ipc_radio_pdu_t;
 
 typedef struct __attribute__((packed)) {
-    db_radio_ble_mode_t mode;       ///< db_radio_init function parameters
-    uint8_t             frequency;  ///< db_set_frequency function parameters
-    uint8_t             channel;    ///< db_set_channel function parameters
-    uint32_t            addr;       ///< db_set_network_address function parameters
-    ipc_radio_pdu_t     tx_pdu;     ///< PDU to send
-    ipc_radio_pdu_t     rx_pdu;     ///< Received pdu
-} ipc_radio_data_t;
+    uint8_t event;  ///< Type of the message (ipc_event_type_t)
+    uint8_t id;     ///< Identifier of the request, copied in its acknowledgment
+    union {
+        uint8_t         mode;       ///< db_radio_init function parameters
+        uint8_t         frequency;  ///< db_set_frequency function parameters
+        uint8_t         channel;    ///< db_set_channel function parameters
+        uint32_t        addr;       ///< db_set_network_address function parameters
+        uint8_t         value;      ///< Value returned with an acknowledgment
+        ipc_radio_pdu_t pdu;        ///< PDU to send or received pdu
+    };
+} ipc_message_t;
 
 typedef struct {
-    uint8_t value;  ///< Byte containing the random value read
-} ipc_rng_data_t;
+    volatile uint32_t head;                      ///< Free running write index, only modified by the producer core
+    volatile uint32_t tail;                      ///< Free running read index, only modified by the consumer core
+    ipc_message_t     messages[IPC_RING_SLOTS];  ///< Storage of the messages
+} ipc_ring_t;
 
-typedef struct __attribute__((packed)) {
-    ipc_event_type_t event;  ///< IPC event
-    ipc_radio_data_t radio;  ///< Radio shared data
-    ipc_rng_data_t   rng;    ///< Rng share data
+typedef struct {
+    volatile uint32_t head;                     ///< Free running write index, only modified by the network core
+    volatile uint32_t tail;                     ///< Free running read index, only modified by the application core
+    uint8_t           bytes[IPC_ENTROPY_SIZE];  ///< Random bytes produced by the RNG of the network core
+} ipc_entropy_t;
+
+typedef struct {
+    ipc_ring_t    app_to_net;  ///< Requests sent by the application core
+    ipc_ring_t    net_to_app;  ///< Acknowledgments and received pdus sent by the network core
+    ipc_entropy_t entropy;     ///< Pool of random bytes, filled in the background by the network core
 } ipc_shared_data_t;
 
+_Static_assert(sizeof(ipc_shared_data_t) <= IPC_SHARED_RAM_SIZE, "IPC rings don't fit in the shared RAM region");
+
+typedef void (*ipc_cb_t)(const ipc_message_t *message);  ///< Callback function prototype, called for each received pdu or completed request
+
+//=========================== ring =============================================
+
+/**
+ * @brief Get the slot where the next message is written (producer side)
+ *
+ * @param[in] ring  Pointer to the ring
+ *
+ * @return a pointer to the free slot, NULL if the ring is full
+ */
+static inline ipc_message_t *ipc_ring_reserve(volatile ipc_ring_t *ring) {
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == IPC_RING_SLOTS) {
+        return NULL;
+    }
+    return (ipc_message_t *)&ring->messages[head & (IPC_RING_SLOTS - 1)];
+}
+
+/**
+ * @brief Publish the message written in the reserved slot (producer side)
+ *
+ * @param[in] ring  Pointer to the ring
+ */
+static inline void ipc_ring_commit(volatile ipc_ring_t *ring) {
+    // Release: the other core sees the message before the new index
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
 /**
- * @brief Lock the mutex, blocks until the mutex is locked
+ * @brief Get the oldest message of the ring (consumer side)
+ *
+ * @param[in] ring  Pointer to the ring
+ *
+ * @return a pointer to the message, valid until ipc_ring_release is called, NULL if the ring is empty
  */
-static inline void mutex_lock(void) {
-    while (NRF_MUTEX->MUTEX[0]) {}
+static inline ipc_message_t *ipc_ring_peek(volatile ipc_ring_t *ring) {
+    uint32_t tail = ring->tail;
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return NULL;
+    }
+    return (ipc_message_t *)&ring->messages[tail & (IPC_RING_SLOTS - 1)];
 }
 
 /**
- * @brief Unlock the mutex, has no effect if the mutex is already unlocked
+ * @brief Give the slot of the oldest message back to the producer (consumer side)
+ *
+ * @param[in] ring  Pointer to the ring
  */
-static inline void mutex_unlock(void) {
-    NRF_MUTEX->MUTEX[0] = 0;
+static inline void ipc_ring_release(volatile ipc_ring_t *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
 }
 
+//=========================== public ===========================================
+
+/**
+ * @brief Configure the IPC on the application core and start the network core if needed
+ *
+ * Can be called several times, only the first call has an effect.
+ */
+void db_ipc_init(void);
+
+/**
+ * @brief Set the function called on the application core for each pdu received by the network core
+ *
+ * @param[in] callback  Function called from the IPC interrupt, the message is only valid during the call
+ */
+void db_ipc_set_radio_rx_callback(ipc_cb_t callback);
+
+/**
+ * @brief Send a request to the network core without waiting for its acknowledgment
+ *
+ * Requests are processed in order by the network core. This function only blocks when too many
+ * requests are already pending.
+ *
+ * @param[in] message   Request to send, copied before returning
+ * @param[in] callback  Function called from the IPC interrupt with the acknowledgment, can be NULL
+ *
+ * @return the identifier of the request
+ */
+uint8_t db_ipc_network_call_async(const ipc_message_t *message, ipc_cb_t callback);
+
+/**
+ * @brief Send a request to the network core and wait for its acknowledgment
+ *
+ * @param[in,out] message   Request to send, its event and value are overwritten by the acknowledgment
+ */
+void db_ipc_network_call(ipc_message_t *message);
+
 /**
  * @brief Variable in RAM containing the shared data structure
  */
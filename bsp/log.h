@@ -0,0 +1,92 @@
+#ifndef __LOG_H
+#define __LOG_H
+
+/**
+ * @file log.h
+ * @addtogroup BSP
+ *
+ * @brief  Cross-platform declaration "log" bsp module.
+ *
+ * Deferred binary logger, usable from interrupt handlers and left enabled in production builds.
+ * DB_LOG only stores the address of the format string and the raw 32-bit arguments in a RAM
+ * ring, the text is never built on target. Records are read from thread context (e.g. when the
+ * CPU is idle) and sent to the host, where bsp/log_decode.py rebuilds the messages using the
+ * format strings found in the ELF file.
+ *
+ * Writing is lock-free and can be done from any context. Records that don't fit in the ring are
+ * dropped and counted. Only integer conversions are supported in the format strings.
+ *
+ * A record is made of little endian 32-bit words: a header followed by the arguments. The 4 most
+ * significant bits of the header are the number of arguments, the 28 other ones are the address
+ * of the format string.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//=========================== defines ==========================================
+
+#ifndef DB_LOG_BUFFER_WORDS
+#define DB_LOG_BUFFER_WORDS (256U)  ///< Size of the ring in 32-bit words (must be a power of 2)
+#endif
+
+#define DB_LOG_ARGS_MAX     (4U)            ///< Max number of arguments of a record
+#define DB_LOG_ADDRESS_MASK (0x0FFFFFFFUL)  ///< Bits of the header containing the address of the format string
+#define DB_LOG_NARGS_POS    (28U)           ///< Position of the number of arguments in the header
+
+/// Number of arguments passed to DB_LOG (returns DB_LOG_ARGS_MAX + 1 when there are too many)
+#define DB_LOG_NARGS(...)                             _DB_LOG_NARGS(0, ##__VA_ARGS__, 5, 4, 3, 2, 1, 0)
+#define _DB_LOG_NARGS(_0, _1, _2, _3, _4, _5, N, ...) N
+
+/**
+ * @brief Log a message, the arguments are converted to 32-bit integers
+ *
+ * The format string is stored in flash only, as a static constant of the calling function.
+ */
+#define DB_LOG(format, ...)                                                                            \
+    do {                                                                                               \
+        _Static_assert(DB_LOG_NARGS(__VA_ARGS__) <= DB_LOG_ARGS_MAX, "too many arguments for DB_LOG"); \
+        static const char _db_log_format[] __attribute__((section(".rodata.db_log"), used)) = format;  \
+        const uint32_t    _db_log_args[] = { 0, ##__VA_ARGS__ };                                       \
+        db_log_write(_db_log_format, &_db_log_args[1], DB_LOG_NARGS(__VA_ARGS__));                     \
+    } while (0)
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Store a record in the ring, use DB_LOG instead
+ *
+ * @param[in] format    address of the format string
+ * @param[in] args      arguments
+ * @param[in] nargs     number of arguments
+ *
+ * @return true if the record was stored, false if it was dropped because the ring is full
+ */
+bool db_log_write(const char *format, const uint32_t *args, uint8_t nargs);
+
+/**
+ * @brief Move complete records from the ring to a buffer (thread context only)
+ *
+ * @param[out] buffer   buffer where the records are copied
+ * @param[in]  size     size of the buffer in bytes
+ *
+ * @return the number of bytes copied, always a whole number of records
+ */
+size_t db_log_read(uint8_t *buffer, size_t size);
+
+/**
+ * @brief Whether records are waiting in the ring
+ */
+bool db_log_pending(void);
+
+/**
+ * @brief Number of records dropped because the ring was full
+ */
+uint32_t db_log_dropped(void);
+
+#endif
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+
+"""Decode the records of the binary logger (see log.h) using the format strings of the firmware ELF file.
+
+Usage: log_decode.py firmware.elf [records.bin]
+Records are read from stdin when no file is given. Requires pyelftools.
+"""
+
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+ADDRESS_MASK = 0x0FFFFFFF
+NARGS_POS = 28
+CONVERSION = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l)?([diouxXc%])")
+
+
+def read_string(elf, address):
+    for section in elf.iter_sections():
+        start = section["sh_addr"] & ADDRESS_MASK
+        if section["sh_type"] != "PROGBITS" or not start <= address < start + section["sh_size"]:
+            continue
+        data = section.data()[address - start:]
+        return data[:data.index(b"\0")].decode()
+    return None
+
+
+def format_record(template, args):
+    # Arguments are stored as unsigned 32-bit integers, restore the sign of %d/%i conversions
+    values = []
+    for conversion in CONVERSION.findall(template):
+        if conversion == "%":
+            continue
+        value = args[len(values)] if len(values) < len(args) else 0
+        if conversion in "di" and value & 0x80000000:
+            value -= 1 << 32
+        values.append(value)
+    template = CONVERSION.sub(lambda match: match.group(0).replace("hh", "").replace("ll", "").replace("h", "").replace("l", ""), template)
+    return template % tuple(values)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    elf = ELFFile(open(sys.argv[1], "rb"))
+    data = open(sys.argv[2], "rb").read() if len(sys.argv) > 2 else sys.stdin.buffer.read()
+
+    offset = 0
+    while offset + 4 <= len(data):
+        header, = struct.unpack_from("<I", data, offset)
+        nargs = header >> NARGS_POS
+        args = struct.unpack_from(f"<{nargs}I", data, offset + 4)
+        offset += 4 * (1 + nargs)
+        template = read_string(elf, header & ADDRESS_MASK)
+        if template is None:
+            print(f"<unknown format 0x{header & ADDRESS_MASK:08x}> {' '.join(hex(arg) for arg in args)}")
+        else:
+            print(format_record(template, args))
+
+
+if __name__ == "__main__":
+    main()
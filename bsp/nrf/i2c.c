@@ -13,11 +13,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 #include <nrf.h>
 #include "gpio.h"
 #include "i2c.h"
+#include "log.h"
 
 //=========================== defines ==========================================
 
@@ -34,25 +34,28 @@
 #define DB_TWIM_IRQ_HANDLER (SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler)  ///< TWI IRQ handler function
 #define DB_TWIM_IRQ         (SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn)        ///< TWI IRQ
 #endif
-#define DB_TWIM_TX_BUF_SIZE (32U)  ///< TX max buffer size
 
 typedef struct {
-    uint8_t buffer[DB_TWIM_TX_BUF_SIZE];  ///< internal buffer used to send bytes on I2C bus
-    bool    running;                      ///< whether bytes are being sent on the I2C bus
-} i2c_tx_vars_t;
+    uint8_t               buffer[DB_I2C_WRITE_MAX_LENGTH + 1];  ///< register address and bytes of the running write transaction
+    db_i2c_transaction_t *head;                                 ///< running transaction, NULL when the bus is idle
+    db_i2c_transaction_t *tail;                                 ///< last queued transaction
+    uint8_t               reads_left;                           ///< remaining reads of the running transaction
+} i2c_vars_t;
 
 //=========================== prototypes =======================================
 
-void _wait_for_transfer(void);
+static void _start_transaction(db_i2c_transaction_t *transaction);
+static void _wait_for_transaction(const db_i2c_transaction_t *transaction);
 
 //=========================== variables ========================================
 
-static i2c_tx_vars_t _i2c_tx_vars;
+static i2c_vars_t _i2c_vars;
 
 //=========================== public ===========================================
 
 void db_i2c_init(const gpio_t *scl, const gpio_t *sda) {
-    _i2c_tx_vars.running = false;
+    _i2c_vars.head = NULL;
+    _i2c_vars.tail = NULL;
     // clear pending errors
     DB_TWIM->EVENTS_ERROR = 0;
     DB_TWIM->ERRORSRC     = 0;
@@ -76,6 +79,7 @@ void db_i2c_init(const gpio_t *scl, const gpio_t *sda) {
     // set frequency
     DB_TWIM->FREQUENCY = TWIM_FREQUENCY_FREQUENCY_K400;
 
+    DB_TWIM->INTENSET = TWIM_INTEN_STOPPED_Msk | TWIM_INTEN_ERROR_Msk;
     NVIC_EnableIRQ(DB_TWIM_IRQ);
     NVIC_ClearPendingIRQ(DB_TWIM_IRQ);
 
@@ -87,64 +91,140 @@ void db_i2c_begin(void) {
 }
 
 void db_i2c_end(void) {
+    while (db_i2c_busy()) {
+        __WFE();
+    }
     DB_TWIM->ENABLE = (TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos);
 }
 
+void db_i2c_submit(db_i2c_transaction_t *transaction) {
+    assert(!transaction->write || transaction->length <= DB_I2C_WRITE_MAX_LENGTH);
+    transaction->next   = NULL;
+    transaction->status = DB_I2C_STATUS_PENDING;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (_i2c_vars.tail == NULL) {
+        _i2c_vars.head = transaction;
+        _start_transaction(transaction);
+    } else {
+        _i2c_vars.tail->next = transaction;
+    }
+    _i2c_vars.tail = transaction;
+    __set_PRIMASK(primask);
+}
+
+bool db_i2c_busy(void) {
+    return _i2c_vars.head != NULL;
+}
+
 void db_i2c_read_regs(uint8_t addr, uint8_t reg, void *data, size_t len) {
-    DB_TWIM->ADDRESS       = addr;
-    DB_TWIM->TXD.MAXCNT    = 1;
-    DB_TWIM->TXD.PTR       = (uint32_t)&reg;
-    DB_TWIM->RXD.PTR       = (uint32_t)data;
-    DB_TWIM->RXD.MAXCNT    = (uint8_t)len;
-    DB_TWIM->SHORTS        = (1 << TWIM_SHORTS_LASTTX_STARTRX_Pos) | (1 << TWIM_SHORTS_LASTRX_STOP_Pos);
-    DB_TWIM->TASKS_STARTTX = 1;
-    _wait_for_transfer();
+    db_i2c_transaction_t transaction = {
+        .addr   = addr,
+        .reg    = reg,
+        .data   = data,
+        .length = (uint8_t)len,
+    };
+    db_i2c_submit(&transaction);
+    _wait_for_transaction(&transaction);
 }
 
 void db_i2c_write_regs(uint8_t addr, uint8_t reg, const void *data, size_t len) {
-    assert(len + 1 <= DB_TWIM_TX_BUF_SIZE);
-    // concatenate register address and input data in a single TX buffer
-    _i2c_tx_vars.buffer[0] = reg;
-    memcpy(&_i2c_tx_vars.buffer[1], data, len);
-
-    // send the content to write to the register
-    DB_TWIM->ADDRESS       = addr;
-    DB_TWIM->TXD.PTR       = (uint32_t)_i2c_tx_vars.buffer;
-    DB_TWIM->TXD.MAXCNT    = (uint8_t)len + 1;
-    DB_TWIM->SHORTS        = (1 << TWIM_SHORTS_LASTTX_STOP_Pos);
-    DB_TWIM->TASKS_STARTTX = 1;
-    _wait_for_transfer();
+    assert(len <= DB_I2C_WRITE_MAX_LENGTH);
+    db_i2c_transaction_t transaction = {
+        .addr   = addr,
+        .reg    = reg,
+        .write  = true,
+        .data   = (void *)data,
+        .length = (uint8_t)len,
+    };
+    db_i2c_submit(&transaction);
+    _wait_for_transaction(&transaction);
 }
 
 //=========================== private ==========================================
 
-void _wait_for_transfer(void) {
-    DB_TWIM->INTENSET    = TWIM_INTEN_STOPPED_Msk | TWIM_INTEN_ERROR_Msk;
-    _i2c_tx_vars.running = true;
-    while (_i2c_tx_vars.running) {
-        __WFI();
+static void _start_transaction(db_i2c_transaction_t *transaction) {
+    // Called with the TWIM interrupt masked (or from it)
+    DB_TWIM->ENABLE  = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
+    DB_TWIM->ADDRESS = transaction->addr;
+
+    if (transaction->write) {
+        // concatenate register address and input data in a single TX buffer
+        _i2c_vars.buffer[0] = transaction->reg;
+        memcpy(&_i2c_vars.buffer[1], transaction->data, transaction->length);
+        DB_TWIM->TXD.PTR     = (uint32_t)_i2c_vars.buffer;
+        DB_TWIM->TXD.MAXCNT  = transaction->length + 1;
+        DB_TWIM->SHORTS      = (1 << TWIM_SHORTS_LASTTX_STOP_Pos);
+        _i2c_vars.reads_left = 0;
+    } else {
+        // with the list mode, RXD.PTR moves to the next block after each read
+        DB_TWIM->TXD.PTR     = (uint32_t)&transaction->reg;
+        DB_TWIM->TXD.MAXCNT  = 1;
+        DB_TWIM->RXD.PTR     = (uint32_t)transaction->data;
+        DB_TWIM->RXD.MAXCNT  = transaction->length;
+        DB_TWIM->RXD.LIST    = (transaction->count > 1) ? TWIM_RXD_LIST_LIST_ArrayList : TWIM_RXD_LIST_LIST_Disabled;
+        DB_TWIM->SHORTS      = (1 << TWIM_SHORTS_LASTTX_STARTRX_Pos) | (1 << TWIM_SHORTS_LASTRX_STOP_Pos);
+        _i2c_vars.reads_left = (transaction->count > 1) ? transaction->count - 1 : 0;
+    }
+    DB_TWIM->TASKS_STARTTX = 1;
+}
+
+static void _wait_for_transaction(const db_i2c_transaction_t *transaction) {
+    // the interrupt handler calls __SEV when a transaction completes
+    while (transaction->status == DB_I2C_STATUS_PENDING) {
+        __WFE();
     }
 }
 
 //=========================== interrupt ========================================
 
 void DB_TWIM_IRQ_HANDLER(void) {
-    if (DB_TWIM->EVENTS_STOPPED) {
-        DB_TWIM->EVENTS_STOPPED = 0;
-        _i2c_tx_vars.running    = false;
-    }
+    db_i2c_transaction_t *transaction = _i2c_vars.head;
 
     if (DB_TWIM->EVENTS_ERROR) {
         DB_TWIM->EVENTS_ERROR = 0;
-        _i2c_tx_vars.running  = false;
         if (DB_TWIM->ERRORSRC & TWIM_ERRORSRC_ANACK_Msk) {
-            DB_TWIM->ERRORSRC = TWIM_ERRORSRC_ANACK_Msk;
-            puts("NACK on address byte");
+            DB_TWIM->ERRORSRC   = TWIM_ERRORSRC_ANACK_Msk;
+            transaction->status = DB_I2C_STATUS_ADDRESS_NACK;
+            DB_LOG("i2c: NACK on address byte, device 0x%02x", transaction->addr);
         }
         if (DB_TWIM->ERRORSRC & TWIM_ERRORSRC_DNACK_Msk) {
-            DB_TWIM->ERRORSRC = TWIM_ERRORSRC_DNACK_Msk;
-            puts("NACK on data byte");
+            DB_TWIM->ERRORSRC   = TWIM_ERRORSRC_DNACK_Msk;
+            transaction->status = DB_I2C_STATUS_DATA_NACK;
+            DB_LOG("i2c: NACK on data byte, device 0x%02x", transaction->addr);
+        }
+        // the transaction completes with the STOPPED event
+        DB_TWIM->TASKS_STOP = 1;
+    }
+
+    if (DB_TWIM->EVENTS_STOPPED) {
+        DB_TWIM->EVENTS_STOPPED = 0;
+
+        if (transaction->status == DB_I2C_STATUS_PENDING && _i2c_vars.reads_left > 0) {
+            // next read of the list, the TX and RX pointers are already set
+            _i2c_vars.reads_left--;
+            DB_TWIM->TASKS_STARTTX = 1;
+            return;
+        }
+
+        if (transaction->status == DB_I2C_STATUS_PENDING) {
+            transaction->status = DB_I2C_STATUS_OK;
+        }
+        DB_TWIM->RXD.LIST = TWIM_RXD_LIST_LIST_Disabled;
+
+        // start the next transaction before notifying, the callback can submit again
+        _i2c_vars.head    = transaction->next;
+        transaction->next = NULL;
+        if (_i2c_vars.head == NULL) {
+            _i2c_vars.tail = NULL;
+        } else {
+            _start_transaction(_i2c_vars.head);
+        }
+
+        if (transaction->callback) {
+            transaction->callback(transaction);
         }
+        __SEV();
     }
-    DB_TWIM->INTENCLR = TWIM_INTEN_STOPPED_Msk | TWIM_INTEN_ERROR_Msk;
 }
@@ -0,0 +1,186 @@
+/**
+ * @file ipc.c
+ * @addtogroup BSP
+ *
+ * @brief  nrf5340-app-specific definition of the "ipc" bsp module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+#include <nrf.h>
+
+// The rings are driven by the network core firmware directly, only the application core uses this module
+#if defined(NRF5340_XXAA) && defined(NRF_APPLICATION)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ipc.h"
+#include "profile.h"
+#include "timer_hf.h"
+
+//=========================== defines ==========================================
+
+typedef struct {
+    volatile bool busy;      ///< Whether the request is waiting for its acknowledgment or being read
+    volatile bool done;      ///< Whether the acknowledgment of a synchronous request was received
+    bool          wait;      ///< Whether the caller waits for the acknowledgment
+    uint8_t       id;        ///< Identifier of the request
+    uint8_t       event;     ///< Acknowledgment event received
+    uint8_t       value;     ///< Value received with the acknowledgment
+    ipc_cb_t      callback;  ///< Function called when the acknowledgment is received
+} ipc_pending_t;
+
+typedef struct {
+    bool          initialized;               ///< Whether the IPC is already configured
+    volatile bool net_ready;                 ///< Whether the network core is ready to process requests
+    ipc_cb_t      radio_rx_callback;         ///< Function called for each received radio pdu
+    ipc_pending_t pending[IPC_PENDING_MAX];  ///< Requests waiting for their acknowledgment, indexed by identifier
+    uint8_t       next_id;                   ///< Identifier of the next request
+} ipc_vars_t;
+
+//=========================== variables ========================================
+
+static ipc_vars_t _ipc_vars = { 0 };
+
+DB_PROFILE_PROBE(_ipc_isr_probe, DB_PROFILE_ID_IPC_ISR);
+
+//=========================== prototypes =======================================
+
+static ipc_pending_t *_ipc_send(const ipc_message_t *message, ipc_cb_t callback, bool wait);
+static void           _ipc_complete(const ipc_message_t *message);
+
+//=========================== public ===========================================
+
+void db_ipc_init(void) {
+    if (_ipc_vars.initialized) {
+        return;
+    }
+
+    // IPC (address at 0x41012000 => periph ID is 18)
+    NRF_SPU_S->PERIPHID[18].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
+                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
+                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
+
+    // Define RAMREGION 2 (0x20004000 to 0x20005FFF, e.g 8KiB) as non secure. It's used to share data between cores
+    NRF_SPU_S->RAMREGION[2].PERM = (SPU_RAMREGION_PERM_READ_Enable << SPU_RAMREGION_PERM_READ_Pos |
+                                    SPU_RAMREGION_PERM_WRITE_Enable << SPU_RAMREGION_PERM_WRITE_Pos |
+                                    SPU_RAMREGION_PERM_SECATTR_Non_Secure << SPU_RAMREGION_PERM_SECATTR_Pos);
+
+    NRF_IPC_S->INTENSET                            = 1 << DB_IPC_CHAN_NET_TO_APP;
+    NRF_IPC_S->SEND_CNF[DB_IPC_CHAN_APP_TO_NET]    = 1 << DB_IPC_CHAN_APP_TO_NET;
+    NRF_IPC_S->RECEIVE_CNF[DB_IPC_CHAN_NET_TO_APP] = 1 << DB_IPC_CHAN_NET_TO_APP;
+
+    NVIC_EnableIRQ(IPC_IRQn);
+    NVIC_ClearPendingIRQ(IPC_IRQn);
+    NVIC_SetPriority(IPC_IRQn, IPC_IRQ_PRIORITY);
+
+    // Start the network core
+    if (NRF_RESET_S->NETWORK.FORCEOFF != 0) {
+        // The network core is not running, the rings can safely be emptied
+        memset((void *)&ipc_shared_data, 0, sizeof(ipc_shared_data_t));
+
+        db_timer_hf_init();
+        *(volatile uint32_t *)0x50005618ul = 1ul;
+        NRF_RESET_S->NETWORK.FORCEOFF      = (RESET_NETWORK_FORCEOFF_FORCEOFF_Release << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
+        db_timer_hf_delay_us(5);  // Wait for at least five microseconds
+        NRF_RESET_S->NETWORK.FORCEOFF = (RESET_NETWORK_FORCEOFF_FORCEOFF_Hold << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
+        db_timer_hf_delay_us(5);  // Wait for at least one microsecond
+        NRF_RESET_S->NETWORK.FORCEOFF      = (RESET_NETWORK_FORCEOFF_FORCEOFF_Release << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
+        *(volatile uint32_t *)0x50005618ul = 0ul;
+        while (!_ipc_vars.net_ready) {}
+    }
+
+    _ipc_vars.initialized = true;
+}
+
+void db_ipc_set_radio_rx_callback(ipc_cb_t callback) {
+    _ipc_vars.radio_rx_callback = callback;
+}
+
+uint8_t db_ipc_network_call_async(const ipc_message_t *message, ipc_cb_t callback) {
+    return _ipc_send(message, callback, false)->id;
+}
+
+void db_ipc_network_call(ipc_message_t *message) {
+    ipc_pending_t *pending = _ipc_send(message, NULL, true);
+    while (!pending->done) {}
+    message->event = pending->event;
+    message->value = pending->value;
+    pending->busy  = false;
+}
+
+//=========================== private ==========================================
+
+static ipc_pending_t *_ipc_send(const ipc_message_t *message, ipc_cb_t callback, bool wait) {
+    ipc_message_t *request = NULL;
+    ipc_pending_t *pending = NULL;
+    while (request == NULL) {
+        // Requests can be sent from thread and interrupt contexts, but the ring has a single producer.
+        // Interrupts are enabled between attempts so the acknowledgments free the ring and the pending slots.
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        pending = &_ipc_vars.pending[_ipc_vars.next_id & (IPC_PENDING_MAX - 1)];
+        if (!pending->busy && (request = ipc_ring_reserve(&ipc_shared_data.app_to_net)) != NULL) {
+            memcpy(request, message, sizeof(ipc_message_t));
+            request->id       = _ipc_vars.next_id++;
+            pending->busy     = true;
+            pending->done     = false;
+            pending->wait     = wait;
+            pending->id       = request->id;
+            pending->callback = callback;
+            ipc_ring_commit(&ipc_shared_data.app_to_net);
+        }
+        __set_PRIMASK(primask);
+    }
+
+    NRF_IPC_S->TASKS_SEND[DB_IPC_CHAN_APP_TO_NET] = 1;
+    return pending;
+}
+
+static void _ipc_complete(const ipc_message_t *message) {
+    ipc_pending_t *pending = &_ipc_vars.pending[message->id & (IPC_PENDING_MAX - 1)];
+    if (!pending->busy || pending->id != message->id) {
+        return;
+    }
+    if (pending->callback) {
+        pending->callback(message);
+    }
+    if (pending->wait) {
+        // The slot is freed by the waiting caller, once the acknowledgment is read
+        pending->event = message->event;
+        pending->value = message->value;
+        pending->done  = true;
+    } else {
+        pending->busy = false;
+    }
+}
+
+//=========================== interrupt handlers ===============================
+
+void IPC_IRQHandler(void) {
+    DB_PROFILE_BEGIN(_ipc_isr_probe);
+    if (NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_NET_TO_APP]) {
+        NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_NET_TO_APP] = 0;
+
+        // Process all the available messages, the doorbell may ring once for several of them
+        ipc_message_t *message;
+        while ((message = ipc_ring_peek(&ipc_shared_data.net_to_app)) != NULL) {
+            if (message->event == DB_IPC_RADIO_RX) {
+                if (_ipc_vars.radio_rx_callback) {
+                    _ipc_vars.radio_rx_callback(message);
+                }
+            } else if (message->event == DB_IPC_NET_READY_ACK) {
+                _ipc_vars.net_ready = true;
+            } else {
+                _ipc_complete(message);
+            }
+            ipc_ring_release(&ipc_shared_data.net_to_app);
+        }
+    }
+    DB_PROFILE_END(_ipc_isr_probe);
+}
+
+#endif
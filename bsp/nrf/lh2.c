@@ -17,23 +17,24 @@
 
 #include "gpio.h"
 #include "lh2.h"
+#include "resources.h"
 #include "timer_hf.h"
 
 //=========================== defines =========================================
 
-#define SPIM_INTERRUPT_PRIORITY                2           ///< Interrupt priority, as high as it will go
-#define SPI_BUFFER_SIZE                        64          ///< Size of buffers used for SPI communications
-#define SPI_FAKE_SCK_PIN                       6           ///< NOTE: SPIM needs an SCK pin to be defined, P1.6 is used because it's not an available pin in the BCM module.
-#define SPI_FAKE_SCK_PORT                      1           ///< NOTE: SPIM needs an SCK pin to be defined, P1.6 is used because it's not an available pin in the BCM module.
-#define FUZZY_CHIP                             0xFF        ///< not sure what this is about
-#define LH2_LOCATION_ERROR_INDICATOR           0xFFFFFFFF  ///< indicate the location value is false
-#define LH2_POLYNOMIAL_ERROR_INDICATOR         0xFF        ///< indicate the polynomial index is invalid
-#define POLYNOMIAL_BIT_ERROR_INITIAL_THRESHOLD 4           ///< initial threshold of polynomial error
-#define LH2_BUFFER_SIZE                        128         ///< buffer size containing lh2 frames
-#define GPIOTE_CH_IN_ENV_HiToLo                1           ///< falling edge gpio channel
-#define GPIOTE_CH_IN_ENV_LoToHi                2           ///< rising edge gpio channel
-#define PPI_SPI_START_CHAN                     2
-#define PPI_SPI_STOP_CHAN                      3
+#define SPIM_INTERRUPT_PRIORITY                2                            ///< Interrupt priority, as high as it will go
+#define SPI_BUFFER_SIZE                        64                           ///< Size of buffers used for SPI communications
+#define SPI_FAKE_SCK_PIN                       6                            ///< NOTE: SPIM needs an SCK pin to be defined, P1.6 is used because it's not an available pin in the BCM module.
+#define SPI_FAKE_SCK_PORT                      1                            ///< NOTE: SPIM needs an SCK pin to be defined, P1.6 is used because it's not an available pin in the BCM module.
+#define FUZZY_CHIP                             0xFF                         ///< not sure what this is about
+#define LH2_LOCATION_ERROR_INDICATOR           0xFFFFFFFF                   ///< indicate the location value is false
+#define LH2_POLYNOMIAL_ERROR_INDICATOR         0xFF                         ///< indicate the polynomial index is invalid
+#define POLYNOMIAL_BIT_ERROR_INITIAL_THRESHOLD 4                            ///< initial threshold of polynomial error
+#define LH2_BUFFER_SIZE                        128                          ///< buffer size containing lh2 frames
+#define GPIOTE_CH_IN_ENV_HiToLo                DB_GPIOTE_CHAN_LH2_ENV_FALL  ///< falling edge gpio channel
+#define GPIOTE_CH_IN_ENV_LoToHi                DB_GPIOTE_CHAN_LH2_ENV_RISE  ///< rising edge gpio channel
+#define PPI_SPI_START_CHAN                     DB_PPI_CHAN_LH2_SPI_START    ///< envelope falling edge starts the SPI transfer
+#define PPI_SPI_STOP_CHAN                      DB_PPI_CHAN_LH2_SPI_STOP     ///< envelope rising edge stops the SPI transfer
 
 #if defined(NRF5340_XXAA) && defined(NRF_APPLICATION)
 #define NRF_SPIM         NRF_SPIM4_S
@@ -959,8 +960,8 @@ void _ppi_setup(void) {
     NRF_PPI->CH[PPI_SPI_START_CHAN].EEP = gpiote_input_task_addr;  // envelope down
     NRF_PPI->CH[PPI_SPI_START_CHAN].TEP = spi_start_task_addr;     // start spi3 transfer
 
-    NRF_PPI->CH[3].EEP = envelope_input_LoToHi;  // envelope up, finished lh2 data
-    NRF_PPI->CH[3].TEP = spi_stop_task_addr;     // stop spi3 transfer
+    NRF_PPI->CH[PPI_SPI_STOP_CHAN].EEP = envelope_input_LoToHi;  // envelope up, finished lh2 data
+    NRF_PPI->CH[PPI_SPI_STOP_CHAN].TEP = spi_stop_task_addr;     // stop spi3 transfer
 #endif
 }
 
@@ -0,0 +1,94 @@
+/**
+ * @file log.c
+ * @addtogroup BSP
+ *
+ * @brief  nRF52833/nRF52840/nRF5340-specific definition of the "log" bsp module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+#include <nrf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+
+//=========================== defines ==========================================
+
+#define LOG_BUFFER_MASK (DB_LOG_BUFFER_WORDS - 1)  ///< Mask applied to the indexes to get a position in the ring
+
+_Static_assert((DB_LOG_BUFFER_WORDS & LOG_BUFFER_MASK) == 0, "DB_LOG_BUFFER_WORDS must be a power of 2");
+
+typedef struct {
+    uint32_t buffer[DB_LOG_BUFFER_WORDS];  ///< Ring of records, a header of 0 means the record is not complete yet
+    uint32_t head;                         ///< Index of the next word to reserve (free running)
+    uint32_t tail;                         ///< Index of the oldest record (free running)
+    uint32_t dropped;                      ///< Number of records dropped
+} log_vars_t;
+
+//=========================== variables ========================================
+
+static log_vars_t _log_vars = { 0 };
+
+//=========================== public ===========================================
+
+bool db_log_write(const char *format, const uint32_t *args, uint8_t nargs) {
+    uint32_t words = 1 + nargs;
+    uint32_t head  = __atomic_load_n(&_log_vars.head, __ATOMIC_RELAXED);
+
+    // Reserve the words of the record, an interrupt can preempt and reserve its own words in between
+    do {
+        uint32_t tail = __atomic_load_n(&_log_vars.tail, __ATOMIC_ACQUIRE);
+        if (head - tail + words > DB_LOG_BUFFER_WORDS) {
+            __atomic_fetch_add(&_log_vars.dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&_log_vars.head, &head, head + words, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    for (uint8_t arg = 0; arg < nargs; arg++) {
+        _log_vars.buffer[(head + 1 + arg) & LOG_BUFFER_MASK] = args[arg];
+    }
+
+    // The header is written last, it commits the record
+    uint32_t header = ((uint32_t)nargs << DB_LOG_NARGS_POS) | ((uintptr_t)format & DB_LOG_ADDRESS_MASK);
+    __atomic_store_n(&_log_vars.buffer[head & LOG_BUFFER_MASK], header, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t db_log_read(uint8_t *buffer, size_t size) {
+    uint32_t tail   = _log_vars.tail;
+    size_t   length = 0;
+
+    while (1) {
+        // Stop at the first record not committed yet, even if the following ones are
+        uint32_t header = __atomic_load_n(&_log_vars.buffer[tail & LOG_BUFFER_MASK], __ATOMIC_ACQUIRE);
+        if (header == 0) {
+            break;
+        }
+        uint32_t words = 1 + (header >> DB_LOG_NARGS_POS);
+        if (length + words * sizeof(uint32_t) > size) {
+            break;
+        }
+        for (uint32_t word = 0; word < words; word++) {
+            uint32_t position = (tail + word) & LOG_BUFFER_MASK;
+            memcpy(&buffer[length], &_log_vars.buffer[position], sizeof(uint32_t));
+            _log_vars.buffer[position] = 0;
+            length += sizeof(uint32_t);
+        }
+        tail += words;
+    }
+
+    // The words are cleared before they are given back to the writers
+    __atomic_store_n(&_log_vars.tail, tail, __ATOMIC_RELEASE);
+    return length;
+}
+
+bool db_log_pending(void) {
+    return __atomic_load_n(&_log_vars.buffer[_log_vars.tail & LOG_BUFFER_MASK], __ATOMIC_ACQUIRE) != 0;
+}
+
+uint32_t db_log_dropped(void) {
+    return __atomic_load_n(&_log_vars.dropped, __ATOMIC_RELAXED);
+}
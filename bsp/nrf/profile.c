@@ -0,0 +1,153 @@
+/**
+ * @file profile.c
+ * @addtogroup BSP
+ *
+ * @brief  nRF52833/nRF52840/nRF5340-specific definition of the "profile" bsp module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+#include <nrf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+//=========================== defines ==========================================
+
+#define PROFILE_REPORT_HEADER_SIZE (sizeof(uint32_t) + sizeof(uint8_t))  ///< Core frequency and number of probes
+
+typedef struct {
+    db_profile_probe_t *head;   ///< First registered probe
+    db_profile_probe_t *tail;   ///< Last registered probe
+    uint8_t             count;  ///< Number of registered probes
+} profile_vars_t;
+
+//=========================== variables ========================================
+
+static profile_vars_t _profile_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void _profile_register(db_profile_probe_t *probe);
+
+//=========================== public ===========================================
+
+void db_profile_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void db_profile_record(db_profile_probe_t *probe, uint32_t cycles) {
+    // Probes can be shared by interrupts of different priorities
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (!probe->registered) {
+        _profile_register(probe);
+    }
+
+    if (probe->count == 0 || cycles < probe->min) {
+        probe->min = cycles;
+    }
+    if (cycles > probe->max) {
+        probe->max = cycles;
+    }
+    probe->count++;
+    probe->total += cycles;
+
+    // Bin n counts durations in [2^(n-1), 2^n[
+    uint8_t bin = (cycles == 0) ? 0 : 32 - __builtin_clz(cycles);
+    if (bin >= DB_PROFILE_HISTOGRAM_BINS) {
+        bin = DB_PROFILE_HISTOGRAM_BINS - 1;
+    }
+    if (probe->histogram[bin] < UINT16_MAX) {
+        probe->histogram[bin]++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void db_profile_mark(db_profile_probe_t *probe) {
+    probe->mark   = DWT->CYCCNT;
+    probe->marked = true;
+}
+
+void db_profile_latency(db_profile_probe_t *probe) {
+    uint32_t now = DWT->CYCCNT;
+    if (!probe->marked) {
+        return;
+    }
+    probe->marked = false;
+    db_profile_record(probe, now - probe->mark);
+}
+
+void db_profile_reset(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (db_profile_probe_t *probe = _profile_vars.head; probe != NULL; probe = probe->next) {
+        probe->marked = false;
+        probe->count  = 0;
+        probe->min    = 0;
+        probe->max    = 0;
+        probe->total  = 0;
+        memset(probe->histogram, 0, sizeof(probe->histogram));
+    }
+    __set_PRIMASK(primask);
+}
+
+size_t db_profile_report(uint8_t *buffer, size_t size, uint8_t *index) {
+    if (*index >= _profile_vars.count || size < PROFILE_REPORT_HEADER_SIZE + sizeof(db_profile_report_entry_t)) {
+        return 0;
+    }
+
+    db_profile_probe_t *probe = _profile_vars.head;
+    for (uint8_t skip = 0; skip < *index; skip++) {
+        probe = probe->next;
+    }
+
+    size_t  length = PROFILE_REPORT_HEADER_SIZE;
+    uint8_t count  = 0;
+    for (; probe != NULL && length + sizeof(db_profile_report_entry_t) <= size; probe = probe->next) {
+        db_profile_report_entry_t entry;
+
+        // Copy the results at once so they are consistent
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        entry.id    = probe->id;
+        entry.count = probe->count;
+        entry.min   = probe->min;
+        entry.max   = probe->max;
+        entry.mean  = (probe->count) ? (uint32_t)(probe->total / probe->count) : 0;
+        memcpy(entry.histogram, probe->histogram, sizeof(entry.histogram));
+        __set_PRIMASK(primask);
+
+        memcpy(&buffer[length], &entry, sizeof(entry));
+        length += sizeof(entry);
+        count++;
+    }
+
+    uint32_t frequency = SystemCoreClock;
+    memcpy(buffer, &frequency, sizeof(frequency));
+    buffer[sizeof(frequency)] = count;
+    *index += count;
+    return length;
+}
+
+//=========================== private ==========================================
+
+static void _profile_register(db_profile_probe_t *probe) {
+    // Called with interrupts disabled
+    probe->next = NULL;
+    if (_profile_vars.tail == NULL) {
+        _profile_vars.head = probe;
+    } else {
+        _profile_vars.tail->next = probe;
+    }
+    _profile_vars.tail = probe;
+    _profile_vars.count++;
+    probe->registered = true;
+}
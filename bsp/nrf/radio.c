@@ -15,6 +15,7 @@
 #include <string.h>
 
 #include "clock.h"
+#include "profile.h"
 #include "radio.h"
 
 //=========================== defines ==========================================
@@ -41,6 +42,7 @@ typedef struct __attribute__((packed)) {
 typedef struct {
     ble_radio_pdu_t pdu;       ///< Variable that stores the radio PDU (protocol data unit) that arrives and the radio packets that are about to be sent.
     radio_cb_t      callback;  ///< Function pointer, stores the callback to use in the RADIO_Irq handler.
+    int8_t          rssi;      ///< RSSI of the last received packet, in dBm
 } radio_vars_t;
 
 //=========================== variables ========================================
@@ -59,6 +61,8 @@ static const uint8_t _chan_to_freq[40] = {
 
 static radio_vars_t radio_vars = { 0 };
 
+DB_PROFILE_PROBE(_radio_isr_probe, DB_PROFILE_ID_RADIO_ISR);
+
 //========================== prototypes ========================================
 
 static void radio_init_addresses(void);
@@ -192,7 +196,8 @@ void db_radio_rx_enable(void) {
 
     // Configure the Shortcuts to expedite the packet reception.
     NRF_RADIO->SHORTS = (RADIO_SHORTS_READY_START_Enabled << RADIO_SHORTS_READY_START_Pos) |
-                        (RADIO_SHORTS_END_START_Enabled << RADIO_SHORTS_END_START_Pos);
+                        (RADIO_SHORTS_END_START_Enabled << RADIO_SHORTS_END_START_Pos) |
+                        (RADIO_SHORTS_ADDRESS_RSSISTART_Enabled << RADIO_SHORTS_ADDRESS_RSSISTART_Pos);  // Sample the RSSI of each received packet
 
     // Start the Radio for reception
     NRF_RADIO->EVENTS_RXREADY = 0;                                    // Clear the flag before enabling the Radio.
@@ -215,6 +220,16 @@ void db_radio_rx_disable(void) {
     NVIC_DisableIRQ(RADIO_IRQn);
 }
 
+void db_radio_send(uint8_t *tx_buffer, uint8_t length) {
+    db_radio_rx_disable();
+    db_radio_tx(tx_buffer, length);
+    db_radio_rx_enable();
+}
+
+int8_t db_radio_rssi(void) {
+    return radio_vars.rssi;
+}
+
 //=========================== private ==========================================
 
 static void radio_init_addresses(void) {
@@ -238,6 +253,7 @@ static void radio_init_addresses(void) {
  *
  */
 void RADIO_IRQHandler(void) {
+    DB_PROFILE_BEGIN(_radio_isr_probe);
 
     // Check if the interrupt was caused by a fully received package
     if (NRF_RADIO->EVENTS_END) {
@@ -249,9 +265,14 @@ void RADIO_IRQHandler(void) {
         // Clear the Interrupt flag
         NRF_RADIO->EVENTS_CRCOK = 0;
 
+        // The sample started on ADDRESS is long done at the end of the packet, RSSISAMPLE is -dBm
+        radio_vars.rssi = -(int8_t)NRF_RADIO->RSSISAMPLE;
+
         if (radio_vars.callback) {
             // Call callback defined by user.
             radio_vars.callback(radio_vars.pdu.payload, radio_vars.pdu.length);
         }
     }
+
+    DB_PROFILE_END(_radio_isr_probe);
 }
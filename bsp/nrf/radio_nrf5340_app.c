@@ -23,34 +23,17 @@
 //=========================== variables ========================================
 
 static radio_cb_t _radio_callback = NULL;
+static int8_t     _rssi           = 0;
 
-static bool _ack_received[] = {
-    [DB_IPC_NET_READY_ACK]    = false,
-    [DB_IPC_RADIO_INIT_ACK]   = false,
-    [DB_IPC_RADIO_FREQ_ACK]   = false,
-    [DB_IPC_RADIO_CHAN_ACK]   = false,
-    [DB_IPC_RADIO_ADDR_ACK]   = false,
-    [DB_IPC_RADIO_RX_EN_ACK]  = false,
-    [DB_IPC_RADIO_RX_DIS_ACK] = false,
-    [DB_IPC_RADIO_TX_ACK]     = false,
-    [DB_IPC_RNG_INIT_ACK]     = false,
-    [DB_IPC_RNG_READ_ACK]     = false,
-};
-
-//========================== functions =========================================
-
-static inline void _network_call(ipc_event_type_t req, ipc_event_type_t ack) {
-    if (req != DB_IPC_NONE) {
-        ipc_shared_data.event                  = req;
-        NRF_IPC_S->TASKS_SEND[DB_IPC_CHAN_REQ] = 1;
-        mutex_unlock();
-    }
-    while (!_ack_received[ack]) {}
-    _ack_received[ack] = false;
-}
+//=========================== prototypes =======================================
+
+static void _radio_rx(const ipc_message_t *message);
 
 //=========================== public ===========================================
 
+// Requests are processed in order by the network core, only the initialization waits for its
+// acknowledgment. The other functions return as soon as the request is queued.
+
 void db_radio_init(radio_cb_t callback, db_radio_ble_mode_t mode) {
     // On nrf53 configure constant latency mode for better performances
     NRF_POWER_S->TASKS_CONSTLAT = 1;
@@ -74,95 +57,67 @@ void db_radio_init(radio_cb_t callback, db_radio_ble_mode_t mode) {
                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos |
                                    SPU_PERIPHID_PERM_DMASEC_NonSecure << SPU_PERIPHID_PERM_DMASEC_Pos);
 
-    // IPC (address at 0x41012000 => periph ID is 18)
-    NRF_SPU_S->PERIPHID[18].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
-                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
-                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
-
-    // APPMUTEX (address at 0x41030000 => periph ID is 48)
-    NRF_SPU_S->PERIPHID[48].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
-                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
-                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
-
-    // Define RAMREGION 2 (0x20004000 to 0x20005FFF, e.g 8KiB) as non secure. It's used to share data between cores
-    NRF_SPU_S->RAMREGION[2].PERM = (SPU_RAMREGION_PERM_READ_Enable << SPU_RAMREGION_PERM_READ_Pos |
-                                    SPU_RAMREGION_PERM_WRITE_Enable << SPU_RAMREGION_PERM_WRITE_Pos |
-                                    SPU_RAMREGION_PERM_SECATTR_Non_Secure << SPU_RAMREGION_PERM_SECATTR_Pos);
-
-    NRF_IPC_S->INTENSET                          = (1 << DB_IPC_CHAN_ACK | 1 << DB_IPC_CHAN_RADIO_RX);
-    NRF_IPC_S->SEND_CNF[DB_IPC_CHAN_REQ]         = 1 << DB_IPC_CHAN_REQ;
-    NRF_IPC_S->RECEIVE_CNF[DB_IPC_CHAN_ACK]      = 1 << DB_IPC_CHAN_ACK;
-    NRF_IPC_S->RECEIVE_CNF[DB_IPC_CHAN_RADIO_RX] = 1 << DB_IPC_CHAN_RADIO_RX;
-
-    NVIC_EnableIRQ(IPC_IRQn);
-    NVIC_ClearPendingIRQ(IPC_IRQn);
-    NVIC_SetPriority(IPC_IRQn, IPC_IRQ_PRIORITY);
-
-    // Start the network core
-    if (NRF_RESET_NS->NETWORK.FORCEOFF != 0) {
-        NRF_RESET_NS->NETWORK.FORCEOFF = 0;
-        _network_call(DB_IPC_NONE, DB_IPC_NET_READY_ACK);
-    }
+    db_ipc_init();
+    db_ipc_set_radio_rx_callback(_radio_rx);
 
     if (callback) {
         _radio_callback = callback;
     }
 
-    mutex_lock();
-    ipc_shared_data.radio.mode = mode;
-    _network_call(DB_IPC_RADIO_INIT_REQ, DB_IPC_RADIO_INIT_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_INIT_REQ, .mode = (uint8_t)mode };
+    db_ipc_network_call(&message);
 }
 
 void db_radio_set_frequency(uint8_t freq) {
-    mutex_lock();
-    ipc_shared_data.radio.frequency = freq;
-    _network_call(DB_IPC_RADIO_FREQ_REQ, DB_IPC_RADIO_FREQ_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_FREQ_REQ, .frequency = freq };
+    db_ipc_network_call_async(&message, NULL);
 }
 
 void db_radio_set_channel(uint8_t channel) {
-    mutex_lock();
-    ipc_shared_data.radio.channel = channel;
-    _network_call(DB_IPC_RADIO_CHAN_REQ, DB_IPC_RADIO_CHAN_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_CHAN_REQ, .channel = channel };
+    db_ipc_network_call_async(&message, NULL);
 }
 
 void db_radio_set_network_address(uint32_t addr) {
-    mutex_lock();
-    ipc_shared_data.radio.addr = addr;
-    _network_call(DB_IPC_RADIO_ADDR_REQ, DB_IPC_RADIO_ADDR_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_ADDR_REQ, .addr = addr };
+    db_ipc_network_call_async(&message, NULL);
 }
 
 void db_radio_tx(uint8_t *tx_buffer, uint8_t length) {
-    mutex_lock();
-    ipc_shared_data.radio.tx_pdu.length = length;
-    memcpy((void *)ipc_shared_data.radio.tx_pdu.buffer, tx_buffer, length);
-    _network_call(DB_IPC_RADIO_TX_REQ, DB_IPC_RADIO_TX_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_TX_REQ };
+    message.pdu.length    = length;
+    memcpy(message.pdu.buffer, tx_buffer, length);
+    db_ipc_network_call_async(&message, NULL);
 }
 
 void db_radio_rx_enable(void) {
-    mutex_lock();
-    _network_call(DB_IPC_RADIO_RX_EN_REQ, DB_IPC_RADIO_RX_EN_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_RX_EN_REQ };
+    db_ipc_network_call_async(&message, NULL);
 }
 
 void db_radio_rx_disable(void) {
-    mutex_lock();
-    _network_call(DB_IPC_RADIO_RX_DIS_REQ, DB_IPC_RADIO_RX_DIS_ACK);
+    ipc_message_t message = { .event = DB_IPC_RADIO_RX_DIS_REQ };
+    db_ipc_network_call_async(&message, NULL);
 }
 
-//=========================== interrupt handlers ===============================
+void db_radio_send(uint8_t *tx_buffer, uint8_t length) {
+    // The network core runs the whole sequence, this core doesn't wait for the end of the transmission
+    ipc_message_t message = { .event = DB_IPC_RADIO_TX_RX_REQ };
+    message.pdu.length    = length;
+    memcpy(message.pdu.buffer, tx_buffer, length);
+    db_ipc_network_call_async(&message, NULL);
+}
 
-void IPC_IRQHandler(void) {
-    if (NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_ACK]) {
-        NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_ACK] = 0;
-        mutex_lock();
-        _ack_received[ipc_shared_data.event] = true;
-        mutex_unlock();
-    }
-    if (NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_RADIO_RX]) {
-        NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_RADIO_RX] = 0;
-        if (_radio_callback) {
-            mutex_lock();
-            _radio_callback((uint8_t *)ipc_shared_data.radio.rx_pdu.buffer, ipc_shared_data.radio.rx_pdu.length);
-            mutex_unlock();
-        }
+int8_t db_radio_rssi(void) {
+    // Received from the network core together with the last pdu
+    return _rssi;
+}
+
+//=========================== private ==========================================
+
+static void _radio_rx(const ipc_message_t *message) {
+    _rssi = message->pdu.rssi;
+    if (_radio_callback) {
+        _radio_callback((uint8_t *)message->pdu.buffer, message->pdu.length);
     }
 }
@@ -10,6 +10,7 @@
  */
 #include <nrf.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "rng.h"
 
@@ -37,3 +38,9 @@ void db_rng_read(uint8_t *value) {
     *value                 = (uint8_t)NRF_RNG->VALUE;
     NRF_RNG->EVENTS_VALRDY = 0;
 }
+
+void db_rng_read_bytes(uint8_t *buffer, size_t length) {
+    for (size_t index = 0; index < length; index++) {
+        db_rng_read(&buffer[index]);
+    }
+}
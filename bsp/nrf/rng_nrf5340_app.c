@@ -4,6 +4,10 @@
  *
  * @brief  nrf5340-app-specific definition of the "rng" bsp module.
  *
+ * The network core fills a pool of random bytes in shared RAM in the background. Random values
+ * are produced locally by a xoshiro128** generator, seeded and regularly reseeded from this pool,
+ * so reading random bytes doesn't require any exchange with the network core.
+ *
  * @author Alexandre Abadie <alexandre.abadie@inria.fr>
  *
  * @copyright Inria, 2023
@@ -11,92 +15,115 @@
 #include <nrf.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ipc.h"
 #include "rng.h"
 
-//========================== variables =========================================
+//=========================== defines ==========================================
 
-static bool _ack_received[] = {
-    [DB_IPC_NET_READY_ACK] = false,
-    [DB_IPC_RNG_INIT_ACK]  = false,
-    [DB_IPC_RNG_READ_ACK]  = false,
-};
+#define RNG_SEED_BYTES   (16U)    ///< Size of the generator state
+#define RNG_RESEED_BYTES (1024U)  ///< Number of bytes produced before mixing fresh entropy in the state
 
-//========================== functions =========================================
+typedef struct {
+    uint32_t state[RNG_SEED_BYTES / sizeof(uint32_t)];  ///< xoshiro128** state
+    uint32_t produced;                                  ///< Number of bytes produced since the last reseed
+} rng_vars_t;
 
-static inline void _network_call(ipc_event_type_t req, ipc_event_type_t ack) {
-    if (req != DB_IPC_NONE) {
-        ipc_shared_data.event                  = req;
-        NRF_IPC_S->TASKS_SEND[DB_IPC_CHAN_REQ] = 1;
-        mutex_unlock();
-    }
-    while (!_ack_received[ack]) {}
-    _ack_received[ack] = false;
-};
+//=========================== variables ========================================
+
+static rng_vars_t _rng_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static size_t   _rng_reseed(void);
+static uint32_t _rng_next(void);
 
 //=========================== public ===========================================
 
 void db_rng_init(void) {
-
     // RNG (address at 0x41009000 => periph ID is 8)
     NRF_SPU_S->PERIPHID[9].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
 
-    // IPC (address at 0x41012000 => periph ID is 18)
-    NRF_SPU_S->PERIPHID[18].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
-                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
-                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
-
-    // APPMUTEX (address at 0x41030000 => periph ID is 48)
-    NRF_SPU_S->PERIPHID[48].PERM = (SPU_PERIPHID_PERM_SECUREMAPPING_UserSelectable << SPU_PERIPHID_PERM_SECUREMAPPING_Pos |
-                                    SPU_PERIPHID_PERM_SECATTR_NonSecure << SPU_PERIPHID_PERM_SECATTR_Pos |
-                                    SPU_PERIPHID_PERM_PRESENT_IsPresent << SPU_PERIPHID_PERM_PRESENT_Pos);
-
-    // Define RAMREGION 2 (0x20004000 to 0x20005FFF, e.g 8KiB) as non secure. It's used to share data between cores
-    NRF_SPU_S->RAMREGION[2].PERM = (SPU_RAMREGION_PERM_READ_Enable << SPU_RAMREGION_PERM_READ_Pos |
-                                    SPU_RAMREGION_PERM_WRITE_Enable << SPU_RAMREGION_PERM_WRITE_Pos |
-                                    SPU_RAMREGION_PERM_SECATTR_Non_Secure << SPU_RAMREGION_PERM_SECATTR_Pos);
-
-    NRF_IPC_S->INTENSET                     = 1 << DB_IPC_CHAN_ACK;
-    NRF_IPC_S->SEND_CNF[DB_IPC_CHAN_REQ]    = 1 << DB_IPC_CHAN_REQ;
-    NRF_IPC_S->RECEIVE_CNF[DB_IPC_CHAN_ACK] = 1 << DB_IPC_CHAN_ACK;
-
-    NVIC_EnableIRQ(IPC_IRQn);
-    NVIC_ClearPendingIRQ(IPC_IRQn);
-    NVIC_SetPriority(IPC_IRQn, IPC_IRQ_PRIORITY);
-
-    // Start the network core
-    if (NRF_RESET_S->NETWORK.FORCEOFF != 0) {
-        db_timer_hf_init();
-        *(volatile uint32_t *)0x50005618ul = 1ul;
-        NRF_RESET_S->NETWORK.FORCEOFF      = (RESET_NETWORK_FORCEOFF_FORCEOFF_Release << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
-        db_timer_hf_delay_us(5);  // Wait for at least five microseconds
-        NRF_RESET_S->NETWORK.FORCEOFF = (RESET_NETWORK_FORCEOFF_FORCEOFF_Hold << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
-        db_timer_hf_delay_us(5);  // Wait for at least one microsecond
-        NRF_RESET_S->NETWORK.FORCEOFF      = (RESET_NETWORK_FORCEOFF_FORCEOFF_Release << RESET_NETWORK_FORCEOFF_FORCEOFF_Pos);
-        *(volatile uint32_t *)0x50005618ul = 0ul;
-        _network_call(DB_IPC_NONE, DB_IPC_NET_READY_ACK);
-    }
+    db_ipc_init();
+
+    // The network core starts filling the entropy pool once the RNG is initialized
+    ipc_message_t message = { .event = DB_IPC_RNG_INIT_REQ };
+    db_ipc_network_call(&message);
 
-    mutex_lock();
-    _network_call(DB_IPC_RNG_INIT_REQ, DB_IPC_RNG_INIT_ACK);
+    // Wait for a full seed, the generator must never start from a predictable state
+    size_t seeded = 0;
+    while (seeded < RNG_SEED_BYTES) {
+        seeded += _rng_reseed();
+    }
 }
 
 void db_rng_read(uint8_t *value) {
-    mutex_lock();
-    _network_call(DB_IPC_RNG_READ_REQ, DB_IPC_RNG_READ_ACK);
-    *value = ipc_shared_data.rng.value;
+    db_rng_read_bytes(value, 1);
+}
+
+void db_rng_read_bytes(uint8_t *buffer, size_t length) {
+    while (length) {
+        uint32_t random = _rng_next();
+        size_t   count  = (length < sizeof(random)) ? length : sizeof(random);
+        memcpy(buffer, &random, count);
+        buffer += count;
+        length -= count;
+    }
 }
 
-//=========================== interrupt handlers ===============================
+//=========================== private ==========================================
+
+static size_t _rng_reseed(void) {
+    ipc_entropy_t *pool      = (ipc_entropy_t *)&ipc_shared_data.entropy;
+    uint32_t       tail      = pool->tail;
+    uint32_t       available = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE) - tail;
+    size_t         count     = (available < RNG_SEED_BYTES) ? available : RNG_SEED_BYTES;
+    if (count == 0) {
+        // Keep going with the current state, fresh entropy is mixed in at the next call
+        return 0;
+    }
 
-void IPC_IRQHandler(void) {
-    if (NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_ACK]) {
-        NRF_IPC_S->EVENTS_RECEIVE[DB_IPC_CHAN_ACK] = 0;
-        mutex_lock();
-        _ack_received[ipc_shared_data.event] = true;
-        mutex_unlock();
+    // Mix the new bytes in the state instead of replacing it, a partial reseed never lowers the entropy
+    uint8_t *state = (uint8_t *)_rng_vars.state;
+    for (size_t index = 0; index < count; index++) {
+        state[index] ^= pool->bytes[(tail + index) & (IPC_ENTROPY_SIZE - 1)];
     }
+    __atomic_store_n(&pool->tail, tail + count, __ATOMIC_RELEASE);
+    _rng_vars.produced = 0;
+
+    // Ring the doorbell so the network core refills the pool
+    NRF_IPC_S->TASKS_SEND[DB_IPC_CHAN_APP_TO_NET] = 1;
+    return count;
+}
+
+static inline uint32_t _rng_rotl(uint32_t value, uint8_t shift) {
+    return (value << shift) | (value >> (32 - shift));
+}
+
+static uint32_t _rng_next(void) {
+    // The generator can be used from thread and interrupt contexts
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (_rng_vars.produced >= RNG_RESEED_BYTES) {
+        _rng_reseed();
+    }
+
+    uint32_t *s      = _rng_vars.state;
+    uint32_t  result = _rng_rotl(s[1] * 5, 7) * 9;
+    uint32_t  t      = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rng_rotl(s[3], 11);
+    _rng_vars.produced += sizeof(result);
+
+    __set_PRIMASK(primask);
+    return result;
 }
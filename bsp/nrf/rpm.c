@@ -14,49 +14,45 @@
 #include <nrf.h>
 #include "rpm.h"
 #include "gpio.h"
-#include "timer.h"
+#include "resources.h"
+#include "vtimer.h"
 
 //=========================== defines ==========================================
 
 #if defined(NRF5340_XXAA) && defined(NRF_APPLICATION)
 #define NRF_GPIOTE NRF_GPIOTE0_S
-#define NRF_TIMER0 NRF_TIMER0_S
-#define NRF_TIMER1 NRF_TIMER1_S
 #define NRF_PPI    NRF_DPPIC_S
 #elif defined(NRF5340_XXAA) && defined(NRF_NETWORK)
-#define NRF_TIMER0 NRF_TIMER0_NS
-#define NRF_TIMER1 NRF_TIMER1_NS
 #define NRF_PPI    NRF_DPPIC_NS
 #endif
 
-#define RPM_LEFT_TIMER        (NRF_TIMER0)  ///< Timer peripheral used to count left cycles
-#define RPM_LEFT_PPI_CHAN     (0)           ///< PPI channel used between left side timer and gpio
-#define RPM_LEFT_GPIOTE_CHAN  (0)           ///< GPIOTE channel used for left side gpio event
-#define RPM_RIGHT_TIMER       (NRF_TIMER1)  ///< Timer peripheral used to count right cycles
-#define RPM_RIGHT_PPI_CHAN    (1)           ///< PPI channel used between right side timer and gpio
-#define RPM_RIGHT_GPIOTE_CHAN (1)           ///< GPIOTE channel used for right side gpio event
-#define RPM_UPDATE_PERIOD_MS  (50)          ///< Counters update period in ms
+#define RPM_LEFT_TIMER        (DB_RPM_LEFT_TIMER)         ///< Timer peripheral used to count left cycles
+#define RPM_LEFT_PPI_CHAN     (DB_PPI_CHAN_RPM_LEFT)      ///< PPI channel used between left side timer and gpio
+#define RPM_LEFT_GPIOTE_CHAN  (DB_GPIOTE_CHAN_RPM_LEFT)   ///< GPIOTE channel used for left side gpio event
+#define RPM_RIGHT_TIMER       (DB_RPM_RIGHT_TIMER)        ///< Timer peripheral used to count right cycles
+#define RPM_RIGHT_PPI_CHAN    (DB_PPI_CHAN_RPM_RIGHT)     ///< PPI channel used between right side timer and gpio
+#define RPM_RIGHT_GPIOTE_CHAN (DB_GPIOTE_CHAN_RPM_RIGHT)  ///< GPIOTE channel used for right side gpio event
 
 /**
  * Helper macro to compute speed in cm/s
  *
  * computed from the number of cycles measured within the last 50ms (one rotation is 3.77mm distance of the wheel)
  */
-#define RPM_CYCLES_TO_SPEED(cycles) (float)(377.0 * cycles / RPM_UPDATE_PERIOD_MS)
+#define RPM_CYCLES_TO_SPEED(cycles) (float)(377.0 * cycles / DB_RPM_UPDATE_PERIOD_MS)
 
 /**
  * Helper macro to compute rotation per minute
  *
  * 1 cycle corresponds to one rotation, so convert to the number of minutes, given the RTC frequency of 50ms
  */
-#define RPM_CYCLES_TO_RPM(cycles) (60 * 1000 * cycles / RPM_UPDATE_PERIOD_MS)
+#define RPM_CYCLES_TO_RPM(cycles) (60 * 1000 * cycles / DB_RPM_UPDATE_PERIOD_MS)
 
 /**
  * Helper macro to compute rotation per second
  *
  * 1 cycle corresponds to one rotation, so convert to the number of seconds, given the RTC frequency of 50ms
  */
-#define RPM_CYCLES_TO_RPS(cycles) (cycles * 1000 / RPM_UPDATE_PERIOD_MS)
+#define RPM_CYCLES_TO_RPS(cycles) (cycles * 1000 / DB_RPM_UPDATE_PERIOD_MS)
 
 /**
  * Helper struct used to store internal state variables
@@ -66,6 +62,7 @@ typedef struct {
     uint32_t previous_left_counts;
     uint32_t last_right_counts;
     uint32_t previous_right_counts;
+    rpm_cb_t callback;
 } rpm_vars_t;
 
 //=========================== variables ========================================
@@ -84,6 +81,11 @@ static const gpio_t _right_pin = { .port = 0, .pin = 15 };
  */
 static rpm_vars_t _rpm_vars;
 
+/*
+ * Software timer used to update the counters every 50ms
+ */
+static vtimer_t _rpm_timer;
+
 //=========================== prototypes =======================================
 
 /**
@@ -147,9 +149,9 @@ void db_rpm_init(void) {
     // Enable PPI channels
     NRF_PPI->CHENSET = (1 << RPM_RIGHT_PPI_CHAN) | (1 << RPM_LEFT_PPI_CHAN);
 
-    // Configure RTC timer period used to update counters
-    db_timer_init();
-    db_timer_set_periodic_ms(0, RPM_UPDATE_PERIOD_MS, &_update_counters);
+    // Configure the software timer used to update counters, it doesn't take a hardware timer channel
+    db_vtimer_init();
+    db_vtimer_set_periodic_ms(&_rpm_timer, DB_RPM_UPDATE_PERIOD_MS, &_update_counters);
 
     // Start timers used as counters
     RPM_LEFT_TIMER->TASKS_START  = 1;
@@ -169,6 +171,10 @@ void db_rpm_get_values(rpm_values_t *values) {
     values->right.speed = RPM_CYCLES_TO_SPEED(right);
 }
 
+void db_rpm_set_update_callback(rpm_cb_t callback) {
+    _rpm_vars.callback = callback;
+}
+
 //=========================== private ==========================================
 
 static void _update_counters(void) {
@@ -183,6 +189,10 @@ static void _update_counters(void) {
     // Update last counts variables with the value in CC
     _rpm_vars.last_left_counts  = RPM_LEFT_TIMER->CC[0];
     _rpm_vars.last_right_counts = RPM_RIGHT_TIMER->CC[0];
+
+    if (_rpm_vars.callback) {
+        _rpm_vars.callback();
+    }
 }
 
 static uint32_t _db_rpm_left_cycles(void) {
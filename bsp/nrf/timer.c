@@ -34,6 +34,8 @@
 #define TIMER_RTC_CB_CHANS (RTC2_CC_NUM - 1)  ///< Number of channels that can be used for periodic callbacks
 #endif
 
+#define TIMER_RTC_COUNTER_MASK (0x00FFFFFFUL)  ///< The RTC counter is 24 bits wide
+
 typedef struct {
     uint32_t   period_ticks;  ///< Period in ticks between each callback
     bool       one_shot;      ///< Whether this is a one shot callback
@@ -41,8 +43,10 @@ typedef struct {
 } timer_callback_t;
 
 typedef struct {
-    timer_callback_t timer_callback[TIMER_RTC_CB_CHANS];  ///< List of timer callback structs
-    bool             running;                             ///< Whether the delay timer is running
+    timer_callback_t  timer_callback[TIMER_RTC_CB_CHANS];  ///< List of timer callback structs
+    bool              running;                             ///< Whether the delay timer is running
+    bool              initialized;                         ///< Whether the RTC is already configured
+    volatile uint32_t overflows;                           ///< Number of 24 bits counter overflows
 } timer_vars_t;
 
 //=========================== prototypes =======================================
@@ -56,8 +60,15 @@ static timer_vars_t _timer_vars;
 //=========================== public ===========================================
 
 void db_timer_init(void) {
+    // Several modules share the RTC, restarting it would shift their pending timers
+    if (_timer_vars.initialized) {
+        return;
+    }
+    _timer_vars.initialized = true;
+
     // No delay is running after initialization
-    _timer_vars.running = false;
+    _timer_vars.running   = false;
+    _timer_vars.overflows = 0;
 
     // Configure and start Low Frequency clock
     db_lfclk_init();
@@ -66,8 +77,8 @@ void db_timer_init(void) {
     TIMER_RTC->TASKS_STOP  = 1;
     TIMER_RTC->TASKS_CLEAR = 1;
     TIMER_RTC->PRESCALER   = 0;  // Run RTC at 32768Hz
-    TIMER_RTC->EVTENSET    = (RTC_EVTENSET_COMPARE3_Enabled << RTC_EVTENSET_COMPARE3_Pos);
-    TIMER_RTC->INTENSET    = (RTC_EVTENSET_COMPARE3_Enabled << RTC_EVTENSET_COMPARE3_Pos);
+    TIMER_RTC->EVTENSET    = (RTC_EVTENSET_COMPARE3_Enabled << RTC_EVTENSET_COMPARE3_Pos) | (RTC_EVTENSET_OVRFLW_Enabled << RTC_EVTENSET_OVRFLW_Pos);
+    TIMER_RTC->INTENSET    = (RTC_INTENSET_COMPARE3_Enabled << RTC_INTENSET_COMPARE3_Pos) | (RTC_INTENSET_OVRFLW_Enabled << RTC_INTENSET_OVRFLW_Pos);
     NVIC_EnableIRQ(TIMER_RTC_IRQ);
 
     // Start the timer
@@ -78,6 +89,29 @@ uint32_t db_timer_ticks(void) {
     return TIMER_RTC->COUNTER;
 }
 
+uint64_t db_timer_ticks64(void) {
+    uint32_t overflows;
+    uint32_t counter;
+    bool     pending;
+    // Lock-free read: retry if the overflow interrupt was processed in between
+    do {
+        overflows = _timer_vars.overflows;
+        counter   = TIMER_RTC->COUNTER;
+        pending   = TIMER_RTC->EVENTS_OVRFLW;
+    } while (overflows != _timer_vars.overflows);
+
+    // The counter wrapped but the interrupt is not processed yet (interrupts disabled or higher priority context)
+    if (pending && counter < (TIMER_RTC_COUNTER_MASK >> 1)) {
+        overflows++;
+    }
+    return ((uint64_t)overflows << 24) | counter;
+}
+
+uint64_t db_timer_now_us(void) {
+    // 1000000 / 32768 == 15625 / 512
+    return (db_timer_ticks64() * 15625) >> 9;
+}
+
 void db_timer_set_periodic_ms(uint8_t channel, uint32_t ms, timer_cb_t cb) {
     assert(channel >= 0 && channel < TIMER_RTC_CB_CHANS);  // Make sure the required channel is correct
     assert(cb);                                            // Make sure the callback function is valid
@@ -143,6 +177,15 @@ static uint32_t _ms_to_ticks(uint32_t ms) {
 //=========================== interrupt ========================================
 
 void TIMER_RTC_ISR(void) {
+    if (TIMER_RTC->EVENTS_OVRFLW == 1) {
+        // Clear the event and count the overflow at once, db_timer_ticks64 can be called from higher priority interrupts
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        TIMER_RTC->EVENTS_OVRFLW = 0;
+        _timer_vars.overflows++;
+        __set_PRIMASK(primask);
+    }
+
     if (TIMER_RTC->EVENTS_COMPARE[TIMER_RTC_CB_CHANS] == 1) {
         TIMER_RTC->EVENTS_COMPARE[TIMER_RTC_CB_CHANS] = 0;
         _timer_vars.running                           = false;
@@ -26,13 +26,14 @@
 #endif
 #define TIMER_HF_IRQ      (TIMER2_IRQn)        ///< IRQ corresponding to the TIMER used
 #define TIMER_HF_ISR      (TIMER2_IRQHandler)  ///< ISR function handler corresponding to the TIMER used
-#define TIMER_HF_CB_CHANS (TIMER2_CC_NUM - 1)  ///< Number of channels that can be used for periodic callbacks
+#define TIMER_HF_CB_CHANS (TIMER2_CC_NUM - 2)  ///< Number of channels that can be used for periodic callbacks
 #else
 #define TIMER_HF          (NRF_TIMER4)         ///< Backend TIMER peripheral used by the timer
 #define TIMER_HF_IRQ      (TIMER4_IRQn)        ///< IRQ corresponding to the TIMER used
 #define TIMER_HF_ISR      (TIMER4_IRQHandler)  ///< ISR function handler corresponding to the TIMER used
-#define TIMER_HF_CB_CHANS (TIMER4_CC_NUM - 1)  ///< Number of channels that can be used for periodic callbacks
+#define TIMER_HF_CB_CHANS (TIMER4_CC_NUM - 2)  ///< Number of channels that can be used for periodic callbacks
 #endif
+#define TIMER_HF_OVERFLOW_CHAN (TIMER_HF_CB_CHANS + 1)  ///< Channel matching 0, used to count the counter overflows
 
 typedef struct {
     uint32_t      period_us;  ///< Period in ticks between each callback
@@ -43,6 +44,8 @@ typedef struct {
 typedef struct {
     timer_hf_callback_t timer_callback[TIMER_HF_CB_CHANS];  ///< List of timer callback structs
     bool                running;                            ///< Whether the delay timer is running
+    bool                initialized;                        ///< Whether the timer is already configured
+    volatile uint32_t   overflows;                          ///< Number of 32 bits counter overflows
 } timer_hf_vars_t;
 
 //=========================== variables ========================================
@@ -52,6 +55,12 @@ static timer_hf_vars_t _timer_hf_vars;
 //=========================== public ===========================================
 
 void db_timer_hf_init(void) {
+    // Several modules share the timer, restarting it would shift their pending timers
+    if (_timer_hf_vars.initialized) {
+        return;
+    }
+    _timer_hf_vars.initialized = true;
+
     // No delay is running after initialization
     _timer_hf_vars.running = false;
 
@@ -63,6 +72,11 @@ void db_timer_hf_init(void) {
     TIMER_HF->PRESCALER   = 4;  // Run TIMER at 1MHz
     TIMER_HF->BITMODE     = (TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos);
     TIMER_HF->INTENSET    = (1 << (TIMER_INTENSET_COMPARE0_Pos + TIMER_HF_CB_CHANS));
+
+    // The compare event on 0 is only generated when the counter wraps around
+    _timer_hf_vars.overflows             = 0;
+    TIMER_HF->CC[TIMER_HF_OVERFLOW_CHAN] = 0;
+    TIMER_HF->INTENSET                   = (1 << (TIMER_INTENSET_COMPARE0_Pos + TIMER_HF_OVERFLOW_CHAN));
     NVIC_EnableIRQ(TIMER_HF_IRQ);
 
     // Start the timer
@@ -70,8 +84,33 @@ void db_timer_hf_init(void) {
 }
 
 uint32_t db_timer_hf_now(void) {
+    // The delay channel is borrowed and restored at once, a running delay isn't affected (safe from interrupts)
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t delay                             = TIMER_HF->CC[TIMER_HF_CB_CHANS];
     TIMER_HF->TASKS_CAPTURE[TIMER_HF_CB_CHANS] = 1;
-    return TIMER_HF->CC[TIMER_HF_CB_CHANS];
+    uint32_t now                               = TIMER_HF->CC[TIMER_HF_CB_CHANS];
+    TIMER_HF->CC[TIMER_HF_CB_CHANS]            = delay;
+    __set_PRIMASK(primask);
+    return now;
+}
+
+uint64_t db_timer_hf_now64(void) {
+    uint32_t overflows;
+    uint32_t now;
+    bool     pending;
+    // Lock-free read: retry if the overflow interrupt was processed in between
+    do {
+        overflows = _timer_hf_vars.overflows;
+        now       = db_timer_hf_now();
+        pending   = TIMER_HF->EVENTS_COMPARE[TIMER_HF_OVERFLOW_CHAN];
+    } while (overflows != _timer_hf_vars.overflows);
+
+    // The counter wrapped but the interrupt is not processed yet (interrupts disabled or higher priority context)
+    if (pending && now < (UINT32_MAX >> 1)) {
+        overflows++;
+    }
+    return ((uint64_t)overflows << 32) | now;
 }
 
 void db_timer_hf_set_periodic_us(uint8_t channel, uint32_t us, timer_hf_cb_t cb) {
@@ -128,6 +167,15 @@ void db_timer_hf_delay_s(uint32_t s) {
 //=========================== interrupt ========================================
 
 void TIMER_HF_ISR(void) {
+    if (TIMER_HF->EVENTS_COMPARE[TIMER_HF_OVERFLOW_CHAN] == 1) {
+        // Clear the event and count the overflow at once, db_timer_hf_now64 can be called from higher priority interrupts
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        TIMER_HF->EVENTS_COMPARE[TIMER_HF_OVERFLOW_CHAN] = 0;
+        _timer_hf_vars.overflows++;
+        __set_PRIMASK(primask);
+    }
+
     if (TIMER_HF->EVENTS_COMPARE[TIMER_HF_CB_CHANS] == 1) {
         TIMER_HF->EVENTS_COMPARE[TIMER_HF_CB_CHANS] = 0;
         _timer_hf_vars.running                      = false;
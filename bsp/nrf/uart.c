@@ -9,11 +9,15 @@
  * @copyright Inria, 2022
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <nrf.h>
 
+#include "clock.h"
 #include "gpio.h"
+#include "resources.h"
 #include "uart.h"
 
 //=========================== defines ==========================================
@@ -23,31 +27,68 @@
 #define DB_UARTE_IRQ (SERIAL1_IRQn)
 #define DB_UARTE_ISR (SERIAL1_IRQHandler)
 #define NRF_POWER    (NRF_POWER_S)
+#define NRF_PPI      (NRF_DPPIC_S)
 #elif defined(NRF5340_XXAA) && defined(NRF_NETWORK)
 #define DB_UARTE     (NRF_UARTE0_NS)
 #define DB_UARTE_IRQ (SERIAL0_IRQn)
 #define DB_UARTE_ISR (SERIAL0_IRQHandler)
 #define NRF_POWER    (NRF_POWER_NS)
+#define NRF_PPI      (NRF_DPPIC_NS)
 #else
 #define DB_UARTE     (NRF_UARTE0)
 #define DB_UARTE_IRQ (UARTE0_UART0_IRQn)
 #define DB_UARTE_ISR (UARTE0_UART0_IRQHandler)
 #endif
-#define DB_UARTE_CHUNK_SIZE (64U)
+#define DB_UARTE_TX_BUFFER_SIZE (1024U)  ///< Size of the TX ring buffer (must be a power of 2)
+
+#define DB_UARTE_RX_BUFFER_SIZE (64U)      ///< Size of each RX DMA buffer
+#define DB_UARTE_RX_IDLE_BYTES  (4U)       ///< Number of byte durations without data before the pending bytes are delivered
+#define DB_UARTE_RX_IDLE_MIN    (2U)       ///< Minimum number of RTC ticks of the idle timeout (a compare value of 1 after a clear may be missed)
+#define DB_UARTE_BITS_PER_BYTE  (10U)      ///< Number of bits sent on the line per byte (start + 8 data + stop)
+#define DB_UARTE_RTC_FREQUENCY  (32768UL)  ///< Frequency of the idle line RTC
 
 typedef struct {
-    uint8_t      byte;      ///< the byte where received byte on UART is stored
-    uart_rx_cb_t callback;  ///< pointer to the callback function
+    uint8_t       rx_buffers[2][DB_UARTE_RX_BUFFER_SIZE];  ///< Double buffer where received bytes are written by EasyDMA
+    uint8_t       rx_index;                                ///< Index of the buffer currently written by EasyDMA
+    uint8_t       rx_delivered;                            ///< Number of bytes of the current buffer already given to the callback
+    uint32_t      rx_base;                                 ///< Value of the byte counter when EasyDMA started writing the current buffer
+    uart_rx_cb_t  callback;                                ///< pointer to the callback function
+    uint8_t       tx_buffer[DB_UARTE_TX_BUFFER_SIZE];      ///< Ring buffer containing the bytes to send
+    uint16_t      tx_head;                                 ///< Position where the next byte is written in the TX ring
+    uint16_t      tx_tail;                                 ///< Position of the next byte to send from the TX ring
+    uint16_t      tx_pending;                              ///< Number of bytes currently sent by EasyDMA
+    volatile bool tx_busy;                                 ///< Whether EasyDMA is sending bytes
 } uart_vars_t;
 
 //=========================== variables ========================================
 
 static uart_vars_t _uart_vars;  ///< variable handling the UART context
 
+//=========================== prototypes =======================================
+
+static void _db_uart_rx_start(void);
+static void _db_uart_rx_stop(void);
+static void _db_uart_rx_idle_init(uint32_t baudrate);
+static void _db_uart_rx_deliver(uint32_t end);
+static void _db_uart_tx_start(void);
+static void _db_uart_tx_end(void);
+static void _db_uart_tx_poll(void);
+
 //=========================== public ===========================================
 
 void db_uart_init(const gpio_t *rx_pin, const gpio_t *tx_pin, uint32_t baudrate, uart_rx_cb_t callback) {
 
+    if (DB_UARTE->ENABLE) {
+        // UART is reconfigured, make sure the previous reception is over
+        _db_uart_rx_stop();
+        DB_UARTE->TASKS_STOPTX = 1;
+        DB_UARTE->ENABLE       = (UARTE_ENABLE_ENABLE_Disabled << UARTE_ENABLE_ENABLE_Pos);
+    }
+    _uart_vars.tx_head    = 0;
+    _uart_vars.tx_tail    = 0;
+    _uart_vars.tx_pending = 0;
+    _uart_vars.tx_busy    = false;
+
 #if defined(NRF5340_XXAA)
     if (baudrate > 460800) {
         // On nrf53 configure constant latency mode for better performances with high baudrates
@@ -127,46 +168,243 @@ void db_uart_init(const gpio_t *rx_pin, const gpio_t *tx_pin, uint32_t baudrate,
 
     DB_UARTE->ENABLE = (UARTE_ENABLE_ENABLE_Enabled << UARTE_ENABLE_ENABLE_Pos);
 
+    // TX ring buffer is drained from the ENDTX interrupt
+    DB_UARTE->EVENTS_ENDTX = 0;
+    DB_UARTE->INTENSET     = (UARTE_INTENSET_ENDTX_Enabled << UARTE_INTENSET_ENDTX_Pos);
+    NVIC_EnableIRQ(DB_UARTE_IRQ);
+    NVIC_SetPriority(DB_UARTE_IRQ, 0);
+    NVIC_ClearPendingIRQ(DB_UARTE_IRQ);
+
     if (callback) {
-        _uart_vars.callback     = callback;
-        DB_UARTE->RXD.MAXCNT    = 1;
-        DB_UARTE->RXD.PTR       = (uint32_t)&_uart_vars.byte;
-        DB_UARTE->INTENSET      = (UARTE_INTENSET_ENDRX_Enabled << UARTE_INTENSET_ENDRX_Pos);
-        DB_UARTE->SHORTS        = (UARTE_SHORTS_ENDRX_STARTRX_Enabled << UARTE_SHORTS_ENDRX_STARTRX_Pos);
-        DB_UARTE->TASKS_STARTRX = 1;
-        NVIC_EnableIRQ(DB_UARTE_IRQ);
-        NVIC_SetPriority(DB_UARTE_IRQ, 0);
-        NVIC_ClearPendingIRQ(DB_UARTE_IRQ);
+        _uart_vars.callback = callback;
+        _db_uart_rx_idle_init(baudrate);
+        DB_UARTE->INTENSET = (UARTE_INTENSET_ENDRX_Enabled << UARTE_INTENSET_ENDRX_Pos) |
+                             (UARTE_INTENSET_RXSTARTED_Enabled << UARTE_INTENSET_RXSTARTED_Pos);
+        _db_uart_rx_start();
     }
 }
 
+size_t db_uart_tx_free(void) {
+    return DB_UARTE_TX_BUFFER_SIZE - (uint16_t)(_uart_vars.tx_head - _uart_vars.tx_tail);
+}
+
+bool db_uart_write_async(const uint8_t *buffer, size_t length) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (length > db_uart_tx_free()) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    // Copy the bytes in the ring, in 2 parts if the end of the buffer is reached
+    uint16_t head  = _uart_vars.tx_head & (DB_UARTE_TX_BUFFER_SIZE - 1);
+    size_t   first = DB_UARTE_TX_BUFFER_SIZE - head;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&_uart_vars.tx_buffer[head], buffer, first);
+    memcpy(_uart_vars.tx_buffer, &buffer[first], length - first);
+    _uart_vars.tx_head += length;
+
+    if (!_uart_vars.tx_busy) {
+        _db_uart_tx_start();
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
 void db_uart_write(uint8_t *buffer, size_t length) {
-    uint8_t pos = 0;
-    // Send DB_UARTE_CHUNK_SIZE (64 Bytes) maximum at a time
-    while ((pos % DB_UARTE_CHUNK_SIZE) == 0 && pos < length) {
-        DB_UARTE->EVENTS_ENDTX = 0;
-        DB_UARTE->TXD.PTR      = (uint32_t)&buffer[pos];
-        if ((pos + DB_UARTE_CHUNK_SIZE) > length) {
-            DB_UARTE->TXD.MAXCNT = length - pos + 1;
+    // From an interrupt handler or with interrupts masked, the ENDTX interrupt may never run, poll the event instead
+    bool polled = (__get_IPSR() != 0) || (__get_PRIMASK() != 0);
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t chunk = db_uart_tx_free();
+        if (chunk > length - pos) {
+            chunk = length - pos;
+        }
+        if (chunk > 0) {
+            db_uart_write_async(&buffer[pos], chunk);
+            pos += chunk;
+        }
+        if (polled) {
+            _db_uart_tx_poll();
+        } else if (chunk == 0) {
+            __WFE();
+        }
+    }
+
+    // Wait for the bytes to be sent
+    while (_uart_vars.tx_busy) {
+        if (polled) {
+            _db_uart_tx_poll();
         } else {
-            DB_UARTE->TXD.MAXCNT = DB_UARTE_CHUNK_SIZE;
+            __WFE();
         }
-        DB_UARTE->TASKS_STARTTX = 1;
-        while (DB_UARTE->EVENTS_ENDTX == 0) {}
-        pos += DB_UARTE_CHUNK_SIZE;
+    }
+}
+
+//=========================== private ==========================================
+
+static void _db_uart_tx_start(void) {
+    // Send the contiguous bytes available from the tail of the ring
+    uint16_t tail   = _uart_vars.tx_tail & (DB_UARTE_TX_BUFFER_SIZE - 1);
+    uint16_t length = _uart_vars.tx_head - _uart_vars.tx_tail;
+    if (length > DB_UARTE_TX_BUFFER_SIZE - tail) {
+        length = DB_UARTE_TX_BUFFER_SIZE - tail;
+    }
+    _uart_vars.tx_pending   = length;
+    _uart_vars.tx_busy      = true;
+    DB_UARTE->TXD.PTR       = (uint32_t)&_uart_vars.tx_buffer[tail];
+    DB_UARTE->TXD.MAXCNT    = length;
+    DB_UARTE->TASKS_STARTTX = 1;
+}
+
+static void _db_uart_tx_end(void) {
+    DB_UARTE->EVENTS_ENDTX = 0;
+
+    _uart_vars.tx_tail += _uart_vars.tx_pending;
+    if (_uart_vars.tx_head != _uart_vars.tx_tail) {
+        _db_uart_tx_start();
+    } else {
+        _uart_vars.tx_busy = false;
+    }
+}
+
+static void _db_uart_tx_poll(void) {
+    // Interrupts are masked so the UART ISR can't clear the event between the check and the handling
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (_uart_vars.tx_busy && DB_UARTE->EVENTS_ENDTX == 0) {}
+    if (_uart_vars.tx_busy) {
+        _db_uart_tx_end();
+    }
+    __set_PRIMASK(primask);
+}
+
+static void _db_uart_rx_start(void) {
+    // EasyDMA writes in the current buffer, the next one is set when reception is started. The
+    // reception is never stopped, the buffers are swapped by the ENDRX_STARTRX short when full
+    _uart_vars.rx_index             = 0;
+    _uart_vars.rx_delivered         = 0;
+    _uart_vars.rx_base              = 0;
+    DB_UART_RX_COUNTER->TASKS_CLEAR = 1;
+    DB_UARTE->RXD.PTR               = (uint32_t)_uart_vars.rx_buffers[_uart_vars.rx_index];
+    DB_UARTE->RXD.MAXCNT            = DB_UARTE_RX_BUFFER_SIZE;
+    DB_UARTE->SHORTS                = (UARTE_SHORTS_ENDRX_STARTRX_Enabled << UARTE_SHORTS_ENDRX_STARTRX_Pos);
+    DB_UARTE->TASKS_STARTRX         = 1;
+}
+
+static void _db_uart_rx_stop(void) {
+    NVIC_DisableIRQ(DB_UARTE_IRQ);
+    NVIC_DisableIRQ(DB_UART_RX_RTC_IRQ);
+    DB_UART_RX_RTC->TASKS_STOP     = 1;
+    DB_UART_RX_COUNTER->TASKS_STOP = 1;
+    DB_UARTE->INTENCLR             = 0xffffffff;
+    DB_UARTE->SHORTS               = 0;
+    DB_UARTE->EVENTS_RXTO          = 0;
+    DB_UARTE->TASKS_STOPRX         = 1;
+    // A receiver that is not started doesn't generate RXTO, so don't wait forever
+    for (uint32_t timeout = 0xffff; timeout && DB_UARTE->EVENTS_RXTO == 0; timeout--) {}
+    DB_UARTE->EVENTS_RXTO      = 0;
+    DB_UARTE->EVENTS_ENDRX     = 0;
+    DB_UARTE->EVENTS_RXSTARTED = 0;
+}
+
+static void _db_uart_rx_idle_init(uint32_t baudrate) {
+    // The RTC is cleared and started on each received byte, if it reaches the compare value
+    // before the next byte, the line is idle and the bytes received so far are delivered. The
+    // timeout is DB_UARTE_RX_IDLE_BYTES byte durations, rounded up to the RTC resolution (30.5us)
+    // and at least DB_UARTE_RX_IDLE_MIN ticks: above 460800 bauds the line must be idle for more
+    // than 4 bytes (6 bytes at 1 Mbaud). This only delays the delivery, reception goes on.
+    uint32_t ticks = (DB_UARTE_RTC_FREQUENCY * DB_UARTE_BITS_PER_BYTE * DB_UARTE_RX_IDLE_BYTES + baudrate - 1) / baudrate;
+    if (ticks < DB_UARTE_RX_IDLE_MIN) {
+        ticks = DB_UARTE_RX_IDLE_MIN;
+    }
+
+    db_lfclk_init();
+    DB_UART_RX_RTC->TASKS_STOP        = 1;
+    DB_UART_RX_RTC->TASKS_CLEAR       = 1;
+    DB_UART_RX_RTC->PRESCALER         = 0;
+    DB_UART_RX_RTC->CC[0]             = ticks;
+    DB_UART_RX_RTC->EVENTS_COMPARE[0] = 0;
+    DB_UART_RX_RTC->EVTENSET          = (RTC_EVTENSET_COMPARE0_Enabled << RTC_EVTENSET_COMPARE0_Pos);
+    DB_UART_RX_RTC->INTENSET          = (RTC_INTENSET_COMPARE0_Enabled << RTC_INTENSET_COMPARE0_Pos);
+
+    // The TIMER counts the received bytes, it tells how much of the current buffer is filled
+    DB_UART_RX_COUNTER->TASKS_STOP  = 1;
+    DB_UART_RX_COUNTER->MODE        = TIMER_MODE_MODE_LowPowerCounter;
+    DB_UART_RX_COUNTER->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    DB_UART_RX_COUNTER->INTENCLR    = 0xffffffff;
+    DB_UART_RX_COUNTER->TASKS_CLEAR = 1;
+    DB_UART_RX_COUNTER->TASKS_START = 1;
+
+    // RX data ready event clears and starts the idle line RTC and increments the byte counter
+#if defined(NRF5340_XXAA)
+    DB_UARTE->PUBLISH_RXDRDY            = DB_PPI_CHAN_UART_RX_IDLE | (UARTE_PUBLISH_RXDRDY_EN_Enabled << UARTE_PUBLISH_RXDRDY_EN_Pos);
+    DB_UART_RX_RTC->SUBSCRIBE_CLEAR     = DB_PPI_CHAN_UART_RX_IDLE | (RTC_SUBSCRIBE_CLEAR_EN_Enabled << RTC_SUBSCRIBE_CLEAR_EN_Pos);
+    DB_UART_RX_RTC->SUBSCRIBE_START     = DB_PPI_CHAN_UART_RX_IDLE | (RTC_SUBSCRIBE_START_EN_Enabled << RTC_SUBSCRIBE_START_EN_Pos);
+    DB_UART_RX_COUNTER->SUBSCRIBE_COUNT = DB_PPI_CHAN_UART_RX_IDLE | (TIMER_SUBSCRIBE_COUNT_EN_Enabled << TIMER_SUBSCRIBE_COUNT_EN_Pos);
+    NRF_PPI->CHENSET                    = (1 << DB_PPI_CHAN_UART_RX_IDLE);
+#else
+    NRF_PPI->CH[DB_PPI_CHAN_UART_RX_IDLE].EEP   = (uint32_t)&DB_UARTE->EVENTS_RXDRDY;
+    NRF_PPI->CH[DB_PPI_CHAN_UART_RX_IDLE].TEP   = (uint32_t)&DB_UART_RX_RTC->TASKS_CLEAR;
+    NRF_PPI->FORK[DB_PPI_CHAN_UART_RX_IDLE].TEP = (uint32_t)&DB_UART_RX_RTC->TASKS_START;
+    NRF_PPI->CH[DB_PPI_CHAN_UART_RX_COUNT].EEP  = (uint32_t)&DB_UARTE->EVENTS_RXDRDY;
+    NRF_PPI->CH[DB_PPI_CHAN_UART_RX_COUNT].TEP  = (uint32_t)&DB_UART_RX_COUNTER->TASKS_COUNT;
+    NRF_PPI->CHENSET                            = (1 << DB_PPI_CHAN_UART_RX_IDLE) | (1 << DB_PPI_CHAN_UART_RX_COUNT);
+#endif
+
+    NVIC_EnableIRQ(DB_UART_RX_RTC_IRQ);
+    NVIC_SetPriority(DB_UART_RX_RTC_IRQ, 0);
+    NVIC_ClearPendingIRQ(DB_UART_RX_RTC_IRQ);
+}
+
+static void _db_uart_rx_deliver(uint32_t end) {
+    // give the bytes of the current buffer not delivered yet to the callback
+    if (end > _uart_vars.rx_delivered) {
+        _uart_vars.callback(&_uart_vars.rx_buffers[_uart_vars.rx_index][_uart_vars.rx_delivered], end - _uart_vars.rx_delivered);
+        _uart_vars.rx_delivered = end;
     }
 }
 
 //=========================== interrupts =======================================
 
 void DB_UARTE_ISR(void) {
-    // check if the interrupt was caused by a fully received package
+    // check if the bytes sent by EasyDMA are out, then send the next ones
+    if (DB_UARTE->EVENTS_ENDTX) {
+        _db_uart_tx_end();
+    }
+
+    // check if a buffer was filled, EasyDMA already writes in the other one
     if (DB_UARTE->EVENTS_ENDRX) {
         DB_UARTE->EVENTS_ENDRX = 0;
-        // make sure we actually received new data
-        if (DB_UARTE->RXD.AMOUNT != 0) {
-            // process received byte
-            _uart_vars.callback(_uart_vars.byte);
+        _db_uart_rx_deliver(DB_UARTE->RXD.AMOUNT);
+        _uart_vars.rx_index ^= 1;
+        _uart_vars.rx_delivered = 0;
+        _uart_vars.rx_base += DB_UARTE_RX_BUFFER_SIZE;
+    }
+
+    // prepare the next buffer while EasyDMA writes in the current one
+    if (DB_UARTE->EVENTS_RXSTARTED) {
+        DB_UARTE->EVENTS_RXSTARTED = 0;
+        DB_UARTE->RXD.PTR          = (uint32_t)_uart_vars.rx_buffers[_uart_vars.rx_index ^ 1];
+    }
+}
+
+void DB_UART_RX_RTC_ISR(void) {
+    if (DB_UART_RX_RTC->EVENTS_COMPARE[0]) {
+        DB_UART_RX_RTC->EVENTS_COMPARE[0] = 0;
+        DB_UART_RX_RTC->TASKS_STOP        = 1;
+        // the line is idle, the received bytes are already in RAM. When the counter is past the
+        // end of the buffer, ENDRX is pending (same priority) and delivers the rest
+        DB_UART_RX_COUNTER->TASKS_CAPTURE[0] = 1;
+        uint32_t received                    = DB_UART_RX_COUNTER->CC[0] - _uart_vars.rx_base;
+        if (received > DB_UARTE_RX_BUFFER_SIZE) {
+            received = DB_UARTE_RX_BUFFER_SIZE;
         }
+        _db_uart_rx_deliver(received);
     }
 }
@@ -0,0 +1,352 @@
+/**
+ * @file vtimer.c
+ * @addtogroup BSP
+ *
+ * @brief  nRF52833-specific definition of the "vtimer" bsp module.
+ *
+ * Each wheel has 64 slots, a timer is stored in the slot matching its deadline, modulo the wheel
+ * turn. When the hardware channel fires, only the slots elapsed since the previous expiration are
+ * visited, the timers of later turns stay in their slot.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+#include <nrf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "timer.h"
+#include "timer_hf.h"
+#include "vtimer.h"
+
+//=========================== defines ==========================================
+
+#define VTIMER_SLOTS (64U)  ///< Number of slots in a wheel, matches the width of the occupied slots bitmap
+
+typedef enum {
+    VTIMER_WHEEL_RTC,    ///< Wheel based on the RTC timer, in ticks
+    VTIMER_WHEEL_HF,     ///< Wheel based on the high frequency timer, in microseconds
+    VTIMER_WHEEL_COUNT,  ///< Number of wheels
+} vtimer_wheel_id_t;
+
+typedef struct {
+    uint32_t mask;       ///< Mask of the hardware counter
+    uint8_t  shift;      ///< Width of a slot (log2), in counter units
+    uint32_t min_delay;  ///< Minimum delay that can be programmed on the hardware channel
+} vtimer_wheel_config_t;
+
+typedef struct {
+    vtimer_t *slots[VTIMER_SLOTS];  ///< Timers, indexed by deadline
+    uint64_t  occupied;             ///< Bitmap of the non empty slots
+    uint32_t  last;                 ///< Time of the last expiration processing
+    uint32_t  wake;                 ///< Time programmed on the hardware channel
+    bool      scheduled;            ///< Whether the hardware channel is programmed
+} vtimer_wheel_t;
+
+typedef struct {
+    vtimer_wheel_t wheels[VTIMER_WHEEL_COUNT];  ///< RTC and high frequency wheels
+    vtimer_t      *deferred_head;               ///< First expired timer waiting for db_vtimer_process
+    vtimer_t      *deferred_tail;               ///< Last expired timer waiting for db_vtimer_process
+} vtimer_vars_t;
+
+//=========================== variables ========================================
+
+static const vtimer_wheel_config_t _vtimer_config[VTIMER_WHEEL_COUNT] = {
+    [VTIMER_WHEEL_RTC] = { .mask = 0x00FFFFFFUL, .shift = 7, .min_delay = 2 },   // 24 bits counter, 3.9ms slots, 250ms wheel turn
+    [VTIMER_WHEEL_HF]  = { .mask = 0xFFFFFFFFUL, .shift = 10, .min_delay = 5 },  // 32 bits counter, 1.024ms slots, 65ms wheel turn
+};
+
+static vtimer_vars_t _vtimer_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void     _vtimer_start(vtimer_t *timer, vtimer_wheel_id_t id, uint32_t delay, uint32_t period, timer_cb_t cb);
+static uint32_t _vtimer_now(vtimer_wheel_id_t id);
+static bool     _vtimer_is_due(vtimer_wheel_id_t id, uint32_t deadline, uint32_t now);
+static void     _vtimer_insert(vtimer_t *timer);
+static void     _vtimer_remove(vtimer_t *timer);
+static void     _vtimer_schedule(vtimer_wheel_id_t id, uint32_t now, uint32_t delay);
+static void     _vtimer_reschedule(vtimer_wheel_id_t id, uint32_t now);
+static void     _vtimer_expire(vtimer_wheel_id_t id);
+static void     _vtimer_rtc_callback(void);
+static void     _vtimer_hf_callback(void);
+
+//=========================== public ===========================================
+
+void db_vtimer_init(void) {
+    db_timer_init();
+}
+
+void db_vtimer_hf_init(void) {
+    db_timer_hf_init();
+}
+
+void db_vtimer_set_deferred(vtimer_t *timer, bool deferred) {
+    timer->deferred = deferred;
+}
+
+void db_vtimer_set_periodic_ms(vtimer_t *timer, uint32_t ms, timer_cb_t cb) {
+    uint32_t ticks = (uint32_t)((((uint64_t)ms << 15) + 999) / 1000);
+    _vtimer_start(timer, VTIMER_WHEEL_RTC, ticks, ticks, cb);
+}
+
+void db_vtimer_set_oneshot_ticks(vtimer_t *timer, uint32_t ticks, timer_cb_t cb) {
+    _vtimer_start(timer, VTIMER_WHEEL_RTC, ticks, 0, cb);
+}
+
+void db_vtimer_set_oneshot_ms(vtimer_t *timer, uint32_t ms, timer_cb_t cb) {
+    // Round up, the timer must never fire in advance
+    db_vtimer_set_oneshot_ticks(timer, (uint32_t)((((uint64_t)ms << 15) + 999) / 1000), cb);
+}
+
+void db_vtimer_hf_set_periodic_us(vtimer_t *timer, uint32_t us, timer_cb_t cb) {
+    _vtimer_start(timer, VTIMER_WHEEL_HF, us, us, cb);
+}
+
+void db_vtimer_hf_set_oneshot_us(vtimer_t *timer, uint32_t us, timer_cb_t cb) {
+    _vtimer_start(timer, VTIMER_WHEEL_HF, us, 0, cb);
+}
+
+void db_vtimer_stop(vtimer_t *timer) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->armed) {
+        _vtimer_remove(timer);
+    }
+    // An already expired timer stays in its list until dequeued, but its callback is skipped
+    timer->fire = false;
+    __set_PRIMASK(primask);
+}
+
+void db_vtimer_process(void) {
+    while (1) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        vtimer_t *timer = _vtimer_vars.deferred_head;
+        if (timer == NULL) {
+            __set_PRIMASK(primask);
+            return;
+        }
+        _vtimer_vars.deferred_head = timer->link;
+        if (_vtimer_vars.deferred_head == NULL) {
+            _vtimer_vars.deferred_tail = NULL;
+        }
+        bool fire     = timer->fire;
+        timer->queued = false;
+        timer->fire   = false;
+        __set_PRIMASK(primask);
+
+        if (fire && timer->callback) {
+            timer->callback();
+        }
+    }
+}
+
+//=========================== private ==========================================
+
+static void _vtimer_start(vtimer_t *timer, vtimer_wheel_id_t id, uint32_t delay, uint32_t period, timer_cb_t cb) {
+    vtimer_wheel_t *wheel = &_vtimer_vars.wheels[id];
+    uint32_t        mask  = _vtimer_config[id].mask;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->armed) {
+        _vtimer_remove(timer);
+    }
+    // Restarting a timer cancels its pending expiration
+    timer->fire = false;
+
+    uint32_t now = _vtimer_now(id);
+    if (wheel->occupied == 0) {
+        // The wheel was idle, there is no elapsed slot to visit
+        wheel->last = now;
+    }
+    timer->wheel    = id;
+    timer->deadline = (now + delay) & mask;
+    timer->period   = period;
+    timer->callback = cb;
+    _vtimer_insert(timer);
+
+    // Only reprogram the hardware channel when the new timer is the first to expire
+    if (!wheel->scheduled || ((timer->deadline - wheel->wake) & mask) > (mask >> 1)) {
+        _vtimer_schedule(id, now, delay);
+    }
+    __set_PRIMASK(primask);
+}
+
+static uint32_t _vtimer_now(vtimer_wheel_id_t id) {
+    if (id == VTIMER_WHEEL_HF) {
+        return db_timer_hf_now();
+    }
+    return db_timer_ticks();
+}
+
+static bool _vtimer_is_due(vtimer_wheel_id_t id, uint32_t deadline, uint32_t now) {
+    uint32_t mask = _vtimer_config[id].mask;
+    return ((now - deadline) & mask) <= (mask >> 1);
+}
+
+static void _vtimer_insert(vtimer_t *timer) {
+    vtimer_wheel_t *wheel = &_vtimer_vars.wheels[timer->wheel];
+    uint8_t         slot  = (timer->deadline >> _vtimer_config[timer->wheel].shift) & (VTIMER_SLOTS - 1);
+
+    timer->prev = NULL;
+    timer->next = wheel->slots[slot];
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    wheel->slots[slot] = timer;
+    wheel->occupied |= (1ULL << slot);
+    timer->armed = true;
+}
+
+static void _vtimer_remove(vtimer_t *timer) {
+    vtimer_wheel_t *wheel = &_vtimer_vars.wheels[timer->wheel];
+    uint8_t         slot  = (timer->deadline >> _vtimer_config[timer->wheel].shift) & (VTIMER_SLOTS - 1);
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel->slots[slot] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    if (wheel->slots[slot] == NULL) {
+        wheel->occupied &= ~(1ULL << slot);
+    }
+    timer->armed = false;
+}
+
+static void _vtimer_schedule(vtimer_wheel_id_t id, uint32_t now, uint32_t delay) {
+    vtimer_wheel_t *wheel = &_vtimer_vars.wheels[id];
+    if (delay < _vtimer_config[id].min_delay) {
+        delay = _vtimer_config[id].min_delay;
+    }
+    wheel->wake      = (now + delay) & _vtimer_config[id].mask;
+    wheel->scheduled = true;
+    if (id == VTIMER_WHEEL_HF) {
+        db_timer_hf_set_oneshot_us(DB_VTIMER_HF_CHANNEL, delay, &_vtimer_hf_callback);
+    } else {
+        db_timer_set_oneshot_ticks(DB_VTIMER_CHANNEL, delay, &_vtimer_rtc_callback);
+    }
+}
+
+static void _vtimer_reschedule(vtimer_wheel_id_t id, uint32_t now) {
+    vtimer_wheel_t *wheel = &_vtimer_vars.wheels[id];
+    uint32_t        mask  = _vtimer_config[id].mask;
+    uint8_t         shift = _vtimer_config[id].shift;
+    if (wheel->occupied == 0) {
+        return;
+    }
+
+    // Visit the non empty slots in expiration order, starting from the current one
+    uint8_t  current  = (now >> shift) & (VTIMER_SLOTS - 1);
+    uint64_t occupied = (current) ? (wheel->occupied >> current) | (wheel->occupied << (VTIMER_SLOTS - current)) : wheel->occupied;
+    while (occupied) {
+        uint8_t slot = (current + __builtin_ctzll(occupied)) & (VTIMER_SLOTS - 1);
+        occupied &= occupied - 1;
+
+        // The first slot containing a timer of the current wheel turn contains the next expiration
+        bool     found = false;
+        uint32_t delay = 0;
+        for (vtimer_t *timer = wheel->slots[slot]; timer != NULL; timer = timer->next) {
+            uint32_t remaining = (timer->deadline - now) & mask;
+            if (_vtimer_is_due(id, timer->deadline, now)) {
+                remaining = 0;
+            } else if ((((timer->deadline >> shift) - (now >> shift)) & (mask >> shift)) >= VTIMER_SLOTS) {
+                continue;
+            }
+            if (!found || remaining < delay) {
+                found = true;
+                delay = remaining;
+            }
+        }
+        if (found) {
+            _vtimer_schedule(id, now, delay);
+            return;
+        }
+    }
+
+    // All timers expire after more than a wheel turn, check again after one turn
+    _vtimer_schedule(id, now, VTIMER_SLOTS << shift);
+}
+
+static void _vtimer_expire(vtimer_wheel_id_t id) {
+    vtimer_wheel_t *wheel   = &_vtimer_vars.wheels[id];
+    uint32_t        mask    = _vtimer_config[id].mask;
+    uint8_t         shift   = _vtimer_config[id].shift;
+    vtimer_t       *expired = NULL;
+    vtimer_t      **tail    = &expired;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    wheel->scheduled = false;
+    uint32_t now     = _vtimer_now(id);
+
+    // Visit the slots elapsed since the last expiration, at most a full wheel turn
+    uint32_t first = wheel->last >> shift;
+    uint32_t steps = ((now >> shift) - first) & (mask >> shift);
+    if (steps >= VTIMER_SLOTS) {
+        steps = VTIMER_SLOTS - 1;
+    }
+    for (uint32_t step = 0; step <= steps; step++) {
+        vtimer_t *timer = wheel->slots[(first + step) & (VTIMER_SLOTS - 1)];
+        while (timer != NULL) {
+            vtimer_t *next = timer->next;
+            if (_vtimer_is_due(id, timer->deadline, now)) {
+                _vtimer_remove(timer);
+                if (timer->period) {
+                    // Periodic timers don't drift, unless they are late by more than one period
+                    timer->deadline = (timer->deadline + timer->period) & mask;
+                    if (_vtimer_is_due(id, timer->deadline, now)) {
+                        timer->deadline = (now + timer->period) & mask;
+                    }
+                    _vtimer_insert(timer);
+                }
+                timer->fire = true;
+                if (!timer->queued) {
+                    // A deferred timer still queued from a previous expiration is only called once
+                    timer->queued = true;
+                    timer->link   = NULL;
+                    if (timer->deferred) {
+                        if (_vtimer_vars.deferred_tail) {
+                            _vtimer_vars.deferred_tail->link = timer;
+                        } else {
+                            _vtimer_vars.deferred_head = timer;
+                        }
+                        _vtimer_vars.deferred_tail = timer;
+                    } else {
+                        *tail = timer;
+                        tail  = &timer->link;
+                    }
+                }
+            }
+            timer = next;
+        }
+    }
+    wheel->last = now;
+    _vtimer_reschedule(id, now);
+    __set_PRIMASK(primask);
+
+    // Callbacks are called with interrupts enabled, they can start or stop any timer
+    while (expired != NULL) {
+        vtimer_t *timer = expired;
+        expired         = timer->link;
+        bool fire       = timer->fire;
+        timer->queued   = false;
+        timer->fire     = false;
+        if (fire && timer->callback) {
+            timer->callback();
+        }
+    }
+}
+
+static void _vtimer_rtc_callback(void) {
+    _vtimer_expire(VTIMER_WHEEL_RTC);
+}
+
+static void _vtimer_hf_callback(void) {
+    _vtimer_expire(VTIMER_WHEEL_HF);
+}
@@ -0,0 +1,150 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+/**
+ * @file profile.h
+ * @addtogroup BSP
+ *
+ * @brief  Cross-platform declaration "profile" bsp module.
+ *
+ * Lightweight instrumentation based on the DWT cycle counter of the Cortex-M4/M33 cores. Each
+ * probe accumulates the number of samples, the min/max/mean duration and a log2 histogram of the
+ * durations, in CPU cycles.
+ *
+ * Two kinds of measurements are available:
+ * - scopes, DB_PROFILE_BEGIN/DB_PROFILE_END around a piece of code (also in interrupt handlers)
+ * - latencies, DB_PROFILE_MARK where an event is triggered (e.g. in an interrupt handler) and
+ *   DB_PROFILE_LATENCY where the event is handled
+ *
+ * The probes are only accessed through the macros, they are compiled out when DB_PROFILE_ENABLED
+ * is 0 (default in release builds).
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <nrf.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//=========================== defines ==========================================
+
+#ifndef DB_PROFILE_ENABLED
+#if defined(DEBUG)
+#define DB_PROFILE_ENABLED (1)  ///< Set to 1 to enable the probes
+#else
+#define DB_PROFILE_ENABLED (0)  ///< Set to 1 to enable the probes
+#endif
+#endif
+
+#define DB_PROFILE_HISTOGRAM_BINS (24U)  ///< Bin 0 counts 0 cycle durations, bin n counts durations in [2^(n-1), 2^n[, the last one also longer durations
+
+/// Identifiers of the probes defined in bsp and drv modules, identifiers below 0x80 are free for the applications
+typedef enum {
+    DB_PROFILE_ID_RADIO_ISR   = 0x80,  ///< Radio interrupt handler
+    DB_PROFILE_ID_IPC_ISR     = 0x81,  ///< IPC interrupt handler (radio on the nRF5340 application core)
+    DB_PROFILE_ID_AHRS_UPDATE = 0x82,  ///< AHRS filter update
+} db_profile_id_t;
+
+typedef struct db_profile_probe db_profile_probe_t;
+
+/// Probe, defined with DB_PROFILE_PROBE
+struct db_profile_probe {
+    db_profile_probe_t *next;                                  ///< Next registered probe
+    uint8_t             id;                                    ///< Identifier of the probe in the reports
+    bool                registered;                            ///< Whether the probe is in the list of reported probes
+    bool                marked;                                ///< Whether a latency mark is pending
+    uint32_t            mark;                                  ///< Cycle counter value of the pending latency mark
+    uint32_t            count;                                 ///< Number of samples
+    uint32_t            min;                                   ///< Shortest duration, in cycles
+    uint32_t            max;                                   ///< Longest duration, in cycles
+    uint64_t            total;                                 ///< Sum of the durations, in cycles
+    uint16_t            histogram[DB_PROFILE_HISTOGRAM_BINS];  ///< Log2 histogram of the durations (saturated counters)
+};
+
+/// Probe results as written in a report, a report starts with the core frequency (4 bytes) and the number of probes (1 byte)
+typedef struct __attribute__((packed)) {
+    uint8_t  id;                                    ///< Identifier of the probe
+    uint32_t count;                                 ///< Number of samples
+    uint32_t min;                                   ///< Shortest duration, in cycles
+    uint32_t max;                                   ///< Longest duration, in cycles
+    uint32_t mean;                                  ///< Mean duration, in cycles
+    uint16_t histogram[DB_PROFILE_HISTOGRAM_BINS];  ///< Log2 histogram of the durations
+} db_profile_report_entry_t;
+
+#if DB_PROFILE_ENABLED
+/// Current value of the cycle counter
+#define DB_PROFILE_CYCLES() (DWT->CYCCNT)
+/// Define a probe (static storage)
+#define DB_PROFILE_PROBE(name, identifier) static db_profile_probe_t name = { .id = (identifier) }
+/// Initialize the cycle counter
+#define DB_PROFILE_INIT() db_profile_init()
+/// Start a scope, must be in the same block as the matching DB_PROFILE_END
+#define DB_PROFILE_BEGIN(name) uint32_t name##_begin = DB_PROFILE_CYCLES()
+/// End a scope and record its duration
+#define DB_PROFILE_END(name) db_profile_record(&(name), DB_PROFILE_CYCLES() - name##_begin)
+/// Mark the time an event is triggered
+#define DB_PROFILE_MARK(name) db_profile_mark(&(name))
+/// Record the time elapsed since the last mark, if any
+#define DB_PROFILE_LATENCY(name) db_profile_latency(&(name))
+#else
+#define DB_PROFILE_CYCLES()                (0)
+#define DB_PROFILE_PROBE(name, identifier) _Static_assert(1, #name)
+#define DB_PROFILE_INIT()                  do {} while (0)
+#define DB_PROFILE_BEGIN(name)             do {} while (0)
+#define DB_PROFILE_END(name)               do {} while (0)
+#define DB_PROFILE_MARK(name)              do {} while (0)
+#define DB_PROFILE_LATENCY(name)           do {} while (0)
+#endif
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Enable and reset the DWT cycle counter
+ */
+void db_profile_init(void);
+
+/**
+ * @brief Add a sample to a probe, use DB_PROFILE_END instead
+ *
+ * @param[in] probe     pointer to the probe
+ * @param[in] cycles    duration of the sample, in cycles
+ */
+void db_profile_record(db_profile_probe_t *probe, uint32_t cycles);
+
+/**
+ * @brief Mark the time an event is triggered, use DB_PROFILE_MARK instead
+ *
+ * @param[in] probe     pointer to the probe
+ */
+void db_profile_mark(db_profile_probe_t *probe);
+
+/**
+ * @brief Add the time elapsed since the last mark to a probe, use DB_PROFILE_LATENCY instead
+ *
+ * @param[in] probe     pointer to the probe
+ */
+void db_profile_latency(db_profile_probe_t *probe);
+
+/**
+ * @brief Clear the results of all the probes
+ */
+void db_profile_reset(void);
+
+/**
+ * @brief Write the results of the probes in a buffer
+ *
+ * Call it repeatedly with the same index until it returns 0 when the results don't fit in a
+ * single buffer.
+ *
+ * @param[out]    buffer    buffer where the report is written
+ * @param[in]     size      size of the buffer
+ * @param[in,out] index     index of the first probe to write, updated with the next one (start with 0)
+ *
+ * @return the number of bytes written, 0 when all the probes were written
+ */
+size_t db_profile_report(uint8_t *buffer, size_t size, uint8_t *index);
+
+#endif
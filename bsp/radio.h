@@ -97,4 +97,26 @@ void db_radio_rx_enable(void);
  */
 void db_radio_rx_disable(void);
 
+/**
+ * @brief Sends a single packet and goes back to receiving packets
+ *
+ * Equivalent to db_radio_rx_disable, db_radio_tx and db_radio_rx_enable. On the nRF5340
+ * application core the sequence is a single request to the network core and the function returns
+ * before the packet is sent.
+ *
+ * @param[in] packet pointer to the array of data to send over the radio
+ * @param[in] length Number of bytes to send
+ */
+void db_radio_send(uint8_t *packet, uint8_t length);
+
+/**
+ * @brief Returns the RSSI of the last received packet
+ *
+ * The value is updated right before the callback is called, so reading it from the
+ * callback gives the RSSI of the packet being processed.
+ *
+ * @return the received signal strength, in dBm
+ */
+int8_t db_radio_rssi(void);
+
 #endif
@@ -0,0 +1,73 @@
+#ifndef __RESOURCES_H
+#define __RESOURCES_H
+
+/**
+ * @file resources.h
+ * @addtogroup BSP
+ *
+ * @brief  Allocation of the nRF peripherals and channels shared between the bsp modules.
+ *
+ * Modules that take a fixed PPI/DPPI channel, GPIOTE channel, RTC or TIMER instance get it from
+ * this file, so two modules used in the same application never claim the same one.
+ *
+ * | Peripheral | nRF52833/nRF52840           | nRF5340                     |
+ * |------------|-----------------------------|-----------------------------|
+ * | RTC0       | uart (RX idle line)         | uart (RX idle line)         |
+ * | RTC1       | -                           | timer                       |
+ * | RTC2       | timer                       | -                           |
+ * | TIMER0     | rpm (left counter)          | rpm (left counter)          |
+ * | TIMER1     | rpm (right counter)         | rpm (right counter) or uart |
+ * | TIMER2     | -                           | timer_hf                    |
+ * | TIMER3     | uart (RX byte counter)      | -                           |
+ * | TIMER4     | timer_hf                    | -                           |
+ *
+ * The nRF5340 only has 3 TIMER instances: the uart RX byte counter uses TIMER1, so uart and rpm
+ * can't be used in the same nRF5340 application.
+ *
+ * GPIOTE channels used with db_gpio_init_irq are allocated from 0 upward, the fixed channels
+ * below are taken from the top where possible.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <nrf.h>
+
+//=========================== defines ==========================================
+
+#define DB_PPI_CHAN_RPM_LEFT      (0U)  ///< rpm: left encoder event counted by the left TIMER
+#define DB_PPI_CHAN_RPM_RIGHT     (1U)  ///< rpm: right encoder event counted by the right TIMER
+#define DB_PPI_CHAN_LH2_SPI_START (2U)  ///< lh2: envelope falling edge starts the SPI transfer
+#define DB_PPI_CHAN_LH2_SPI_STOP  (3U)  ///< lh2: envelope rising edge stops the SPI transfer
+#define DB_PPI_CHAN_UART_RX_IDLE  (4U)  ///< uart: RX data ready restarts the idle line RTC (and counts the byte on nRF5340)
+#define DB_PPI_CHAN_UART_RX_COUNT (5U)  ///< uart: RX data ready counts the byte (nRF52 only, a DPPI channel has several subscribers)
+
+#define DB_GPIOTE_CHAN_LH2_ENV_FALL (1U)  ///< lh2: envelope falling edge
+#define DB_GPIOTE_CHAN_LH2_ENV_RISE (2U)  ///< lh2: envelope rising edge
+#define DB_GPIOTE_CHAN_RPM_LEFT     (6U)  ///< rpm: left magnetic encoder
+#define DB_GPIOTE_CHAN_RPM_RIGHT    (7U)  ///< rpm: right magnetic encoder
+
+#if defined(NRF5340_XXAA) && defined(NRF_APPLICATION)
+#define DB_RPM_LEFT_TIMER  (NRF_TIMER0_S)  ///< rpm: left encoder counter
+#define DB_RPM_RIGHT_TIMER (NRF_TIMER1_S)  ///< rpm: right encoder counter
+#define DB_UART_RX_RTC     (NRF_RTC0_S)    ///< uart: idle line detection
+#define DB_UART_RX_RTC_IRQ (RTC0_IRQn)     ///< uart: idle line detection IRQ
+#define DB_UART_RX_COUNTER (NRF_TIMER1_S)  ///< uart: received bytes counter
+#elif defined(NRF5340_XXAA) && defined(NRF_NETWORK)
+#define DB_RPM_LEFT_TIMER  (NRF_TIMER0_NS)  ///< rpm: left encoder counter
+#define DB_RPM_RIGHT_TIMER (NRF_TIMER1_NS)  ///< rpm: right encoder counter
+#define DB_UART_RX_RTC     (NRF_RTC0_NS)    ///< uart: idle line detection
+#define DB_UART_RX_RTC_IRQ (RTC0_IRQn)      ///< uart: idle line detection IRQ
+#define DB_UART_RX_COUNTER (NRF_TIMER1_NS)  ///< uart: received bytes counter
+#else
+#define DB_RPM_LEFT_TIMER  (NRF_TIMER0)  ///< rpm: left encoder counter
+#define DB_RPM_RIGHT_TIMER (NRF_TIMER1)  ///< rpm: right encoder counter
+#define DB_UART_RX_RTC     (NRF_RTC0)    ///< uart: idle line detection
+#define DB_UART_RX_RTC_IRQ (RTC0_IRQn)   ///< uart: idle line detection IRQ
+#define DB_UART_RX_COUNTER (NRF_TIMER3)  ///< uart: received bytes counter
+#endif
+
+#define DB_UART_RX_RTC_ISR (RTC0_IRQHandler)  ///< uart: idle line detection ISR
+
+#endif
@@ -13,6 +13,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 
 //=========================== defines ==========================================
 
@@ -30,4 +31,15 @@ void db_rng_init(void);
  */
 void db_rng_read(uint8_t *value);
 
+/**
+ * @brief Read several random bytes
+ *
+ * On the nRF5340 application core, bytes are produced by a fast generator regularly reseeded
+ * from the RNG of the network core. The generator is not suitable for cryptographic use.
+ *
+ * @param[out] buffer   address of the output buffer
+ * @param[in]  length   number of random bytes to read
+ */
+void db_rng_read_bytes(uint8_t *buffer, size_t length);
+
 #endif
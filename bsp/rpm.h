@@ -16,6 +16,10 @@
 
 //=========================== defines ==========================================
 
+#define DB_RPM_UPDATE_PERIOD_MS (50U)  ///< Counters update period in ms, the values change at this rate
+
+typedef void (*rpm_cb_t)(void);  ///< Callback function prototype, it is called from the timer interrupt
+
 /**
  * Structure containing different values computed by the rpm driver
  */
@@ -53,4 +57,12 @@ void db_rpm_init(void);
  */
 void db_rpm_get_values(rpm_values_t *values);
 
+/**
+ * Set a function called each time the counters are updated, e.g. to run a control loop at the
+ * measurement rate
+ *
+ * @param[in] callback  Function called after each update (NULL to disable)
+ */
+void db_rpm_set_update_callback(rpm_cb_t callback);
+
 #endif
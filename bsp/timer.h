@@ -32,6 +32,20 @@ void db_timer_init(void);
  */
 uint32_t db_timer_ticks(void);
 
+/**
+ * @brief Returns the number of ticks since timer initialization, never wraps around
+ *
+ * @return number of ticks (1 tick ~ 30us)
+ */
+uint64_t db_timer_ticks64(void);
+
+/**
+ * @brief Returns the time since timer initialization, never wraps around
+ *
+ * @return time in microseconds, with the RTC resolution (~30us)
+ */
+uint64_t db_timer_now_us(void);
+
 /**
  * @brief Set a callback to be called periodically
  *
@@ -26,10 +26,15 @@ typedef void (*timer_hf_cb_t)(void);
 void db_timer_hf_init(void);
 
 /**
- * @brief Return the current timer time in microseconds
+ * @brief Return the current timer time in microseconds, can be called from interrupt context
  */
 uint32_t db_timer_hf_now(void);
 
+/**
+ * @brief Return the time in microseconds since the timer initialization, never wraps around
+ */
+uint64_t db_timer_hf_now64(void);
+
 /**
  * @brief Set a callback to be called periodically using the high frequency timer
  *
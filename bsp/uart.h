@@ -12,32 +12,61 @@
  * @copyright Inria, 2022
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include "gpio.h"
 
 //=========================== defines ==========================================
 
-typedef void (*uart_rx_cb_t)(uint8_t data);  ///< Callback function prototype, it is called on each byte received
+typedef void (*uart_rx_cb_t)(const uint8_t *data, size_t length);  ///< Callback function prototype, it is called with each chunk of bytes received
 
 //=========================== public ===========================================
 
 /**
  * @brief Initialize the UART interface
  *
+ * Bytes are received by DMA in double buffers. The callback is called from interrupt context
+ * each time a buffer is full or when the line stays idle for a few byte durations, the data
+ * pointer is only valid until the callback returns.
+ *
  * @param[in] rx_pin    pointer to RX pin
  * @param[in] tx_pin    pointer to TX pin
  * @param[in] baudrate  Baudrate in bauds
- * @param[in] callback  callback function called on each received byte
+ * @param[in] callback  callback function called with each chunk of received bytes
  */
 void db_uart_init(const gpio_t *rx_pin, const gpio_t *tx_pin, uint32_t baudrate, uart_rx_cb_t callback);
 
 /**
  * @brief Write bytes to the UART
  *
+ * Bytes are queued in the TX ring buffer and the function returns once they are all sent.
+ * It can be called from an interrupt handler or with interrupts masked, the end of the transfers
+ * is then polled.
+ *
  * @param[in] buffer    pointer to the buffer to write to UART
  * @param[in] length    number of bytes of the buffer to write
  */
 void db_uart_write(uint8_t *buffer, size_t length);
 
+/**
+ * @brief Queue bytes to write to the UART without waiting for them to be sent
+ *
+ * Bytes are copied in the TX ring buffer and sent by DMA from interrupt context. Nothing is
+ * queued if the ring buffer doesn't have enough room for all bytes.
+ *
+ * @param[in] buffer    pointer to the buffer to write to UART
+ * @param[in] length    number of bytes of the buffer to write
+ *
+ * @return true if the bytes were queued, false otherwise
+ */
+bool db_uart_write_async(const uint8_t *buffer, size_t length);
+
+/**
+ * @brief Number of bytes that can be queued in the TX ring buffer
+ *
+ * @return the free space in bytes
+ */
+size_t db_uart_tx_free(void);
+
 #endif
@@ -0,0 +1,133 @@
+#ifndef __VTIMER_H
+#define __VTIMER_H
+
+/**
+ * @file vtimer.h
+ * @addtogroup BSP
+ *
+ * @brief  Cross-platform declaration "vtimer" bsp module.
+ *
+ * Any number of one shot or periodic software timers multiplexed on a single compare channel of
+ * the RTC timer (32768Hz ticks) or of the high frequency timer (microseconds).
+ *
+ * Timers are stored in a timing wheel: inserting, stopping and expiring a timer don't depend on
+ * the number of running timers. The hardware channel is only programmed for the next expiration,
+ * there is no periodic tick.
+ *
+ * By default callbacks are called from the timer interrupt. Deferred callbacks are called from
+ * thread context, by db_vtimer_process, typically in the application main loop.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "timer.h"
+
+//=========================== defines ==========================================
+
+#ifndef DB_VTIMER_CHANNEL
+#define DB_VTIMER_CHANNEL (2)  ///< RTC timer channel used by the software timers
+#endif
+
+#ifndef DB_VTIMER_HF_CHANNEL
+#define DB_VTIMER_HF_CHANNEL (3)  ///< High frequency timer channel used by the software timers
+#endif
+
+typedef struct vtimer vtimer_t;
+
+/// Software timer, the storage is provided by the user and must remain valid while the timer runs
+struct vtimer {
+    vtimer_t  *next;      ///< Next timer in the same wheel slot
+    vtimer_t  *prev;      ///< Previous timer in the same wheel slot
+    vtimer_t  *link;      ///< Next timer in the list of expired timers
+    uint32_t   deadline;  ///< Expiration time, in ticks or microseconds
+    uint32_t   period;    ///< Period of a periodic timer, 0 for a one shot timer
+    timer_cb_t callback;  ///< Function called when the timer expires
+    uint8_t    wheel;     ///< Wheel (RTC or high frequency) the timer is in
+    bool       deferred;  ///< Whether the callback is called from thread context
+    bool       armed;     ///< Whether the timer is in a wheel slot
+    bool       queued;    ///< Whether the timer is in a list of expired timers
+    bool       fire;      ///< Whether the callback must be called when the timer is dequeued
+};
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief Initialize the software timers based on the RTC timer (also initializes the RTC timer)
+ */
+void db_vtimer_init(void);
+
+/**
+ * @brief Initialize the software timers based on the high frequency timer (also initializes it)
+ */
+void db_vtimer_hf_init(void);
+
+/**
+ * @brief Set whether the callback of a timer is called from thread context, by db_vtimer_process
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] deferred  true to defer the callback, false to call it from the interrupt
+ */
+void db_vtimer_set_deferred(vtimer_t *timer, bool deferred);
+
+/**
+ * @brief Start a timer calling a callback periodically (restarts the timer if already running)
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] ms        periodicity in milliseconds (max 256s)
+ * @param[in] cb        callback function
+ */
+void db_vtimer_set_periodic_ms(vtimer_t *timer, uint32_t ms, timer_cb_t cb);
+
+/**
+ * @brief Start a timer calling a callback once after an amount of ticks (1 tick ~= 30us)
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] ticks     delay in ticks (max 2^23)
+ * @param[in] cb        callback function
+ */
+void db_vtimer_set_oneshot_ticks(vtimer_t *timer, uint32_t ticks, timer_cb_t cb);
+
+/**
+ * @brief Start a timer calling a callback once after an amount of milliseconds
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] ms        delay in milliseconds (max 256s)
+ * @param[in] cb        callback function
+ */
+void db_vtimer_set_oneshot_ms(vtimer_t *timer, uint32_t ms, timer_cb_t cb);
+
+/**
+ * @brief Start a high frequency timer calling a callback periodically
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] us        periodicity in microseconds (max 2^31)
+ * @param[in] cb        callback function
+ */
+void db_vtimer_hf_set_periodic_us(vtimer_t *timer, uint32_t us, timer_cb_t cb);
+
+/**
+ * @brief Start a high frequency timer calling a callback once after an amount of microseconds
+ *
+ * @param[in] timer     pointer to the timer
+ * @param[in] us        delay in microseconds (max 2^31)
+ * @param[in] cb        callback function
+ */
+void db_vtimer_hf_set_oneshot_us(vtimer_t *timer, uint32_t us, timer_cb_t cb);
+
+/**
+ * @brief Stop a timer, its callback is not called anymore even if it already expired
+ *
+ * @param[in] timer     pointer to the timer
+ */
+void db_vtimer_stop(vtimer_t *timer);
+
+/**
+ * @brief Call the deferred callbacks of the expired timers, from thread context
+ */
+void db_vtimer_process(void);
+
+#endif
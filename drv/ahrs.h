@@ -0,0 +1,93 @@
+#ifndef __AHRS_H
+#define __AHRS_H
+
+/**
+ * @file ahrs.h
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform declaration "ahrs" driver module.
+ *
+ * Attitude and heading reference system, Mahony complementary filter on a quaternion. The gyroscope
+ * is integrated at each update, the accelerometer (gravity) corrects roll and pitch and the
+ * magnetometer, when available, corrects the heading. The magnetic field is projected on the
+ * horizontal plane by the filter, so the heading is tilt compensated.
+ *
+ * All the vectors are given in the same body frame: x forward, y right, z down. Computations use
+ * single precision floats (hardware FPU). The cost of each update is measured by the
+ * DB_PROFILE_ID_AHRS_UPDATE probe (see profile.h).
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+#define DB_AHRS_KP_DEFAULT (1.0f)  ///< Default proportional gain, higher values trust the accelerometer and magnetometer more
+#define DB_AHRS_KI_DEFAULT (0.0f)  ///< Default integral gain, compensates the gyroscope bias when > 0
+
+typedef struct {
+    float x;  ///< X axis
+    float y;  ///< Y axis
+    float z;  ///< Z axis
+} ahrs_vector_t;
+
+typedef struct {
+    float w;  ///< Scalar part
+    float x;  ///< X component
+    float y;  ///< Y component
+    float z;  ///< Z component
+} ahrs_quaternion_t;
+
+typedef struct {
+    ahrs_quaternion_t q;         ///< Orientation of the body frame relative to the earth frame (north, east, down)
+    ahrs_vector_t     integral;  ///< Integral of the error, in rad/s
+    float             kp;        ///< Proportional gain
+    float             ki;        ///< Integral gain
+} ahrs_t;
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief   Initialize the filter, the orientation is reset
+ *
+ * @param[in] ahrs          Pointer to the ahrs struct
+ * @param[in] kp            Proportional gain
+ * @param[in] ki            Integral gain
+ */
+void db_ahrs_init(ahrs_t *ahrs, float kp, float ki);
+
+/**
+ * @brief   Update the orientation with new samples
+ *
+ * @param[in] ahrs          Pointer to the ahrs struct
+ * @param[in] gyro          Angular rate, in rad/s
+ * @param[in] accel         Specific force (any unit, reads -1g on z when the body is level), NULL when not available
+ * @param[in] mag           Magnetic field (any unit, hard iron offset removed), NULL when not available
+ * @param[in] dt            Time elapsed since the previous update, in seconds
+ */
+void db_ahrs_update(ahrs_t *ahrs, const ahrs_vector_t *gyro, const ahrs_vector_t *accel, const ahrs_vector_t *mag, float dt);
+
+/**
+ * @brief   Heading of the body
+ *
+ * @param[in] ahrs          Pointer to the ahrs struct
+ *
+ * @return the heading in radians, from 0 to 2 PI, clockwise from (magnetic) north
+ */
+float db_ahrs_heading(const ahrs_t *ahrs);
+
+/**
+ * @brief   Roll, pitch and heading of the body
+ *
+ * @param[in]  ahrs         Pointer to the ahrs struct
+ * @param[out] roll         Rotation around x, in radians
+ * @param[out] pitch        Rotation around y, in radians
+ * @param[out] heading      Rotation around z, in radians from 0 to 2 PI
+ */
+void db_ahrs_euler(const ahrs_t *ahrs, float *roll, float *pitch, float *heading);
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file ahrs.c
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform implementation of the "ahrs" driver module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "ahrs.h"
+#include "profile.h"
+
+//=========================== variables ========================================
+
+DB_PROFILE_PROBE(_ahrs_update_probe, DB_PROFILE_ID_AHRS_UPDATE);
+
+//=========================== prototypes =======================================
+
+static inline float _ahrs_inv_norm(float x, float y, float z);
+
+//=========================== public ===========================================
+
+void db_ahrs_init(ahrs_t *ahrs, float kp, float ki) {
+    ahrs->q.w        = 1.0f;
+    ahrs->q.x        = 0.0f;
+    ahrs->q.y        = 0.0f;
+    ahrs->q.z        = 0.0f;
+    ahrs->integral.x = 0.0f;
+    ahrs->integral.y = 0.0f;
+    ahrs->integral.z = 0.0f;
+    ahrs->kp         = kp;
+    ahrs->ki         = ki;
+}
+
+void db_ahrs_update(ahrs_t *ahrs, const ahrs_vector_t *gyro, const ahrs_vector_t *accel, const ahrs_vector_t *mag, float dt) {
+    DB_PROFILE_BEGIN(_ahrs_update_probe);
+
+    float q0 = ahrs->q.w;
+    float q1 = ahrs->q.x;
+    float q2 = ahrs->q.y;
+    float q3 = ahrs->q.z;
+    float gx = gyro->x;
+    float gy = gyro->y;
+    float gz = gyro->z;
+
+    // the accelerometer can't be used for the correction in free fall
+    float norm = (accel) ? _ahrs_inv_norm(accel->x, accel->y, accel->z) : 0;
+    if (norm > 0) {
+        // gravity direction measured (the specific force points up) and estimated, in body frame
+        float ax = -accel->x * norm;
+        float ay = -accel->y * norm;
+        float az = -accel->z * norm;
+        float vx = q1 * q3 - q0 * q2;
+        float vy = q0 * q1 + q2 * q3;
+        float vz = q0 * q0 - 0.5f + q3 * q3;
+
+        // the error is the cross product between the measured and estimated directions
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        norm = (mag) ? _ahrs_inv_norm(mag->x, mag->y, mag->z) : 0;
+        if (norm > 0) {
+            float mx = mag->x * norm;
+            float my = mag->y * norm;
+            float mz = mag->z * norm;
+
+            // the field in earth frame is rotated to the north/down plane, its horizontal part gives the heading
+            float hx = 2.0f * (mx * (0.5f - q2 * q2 - q3 * q3) + my * (q1 * q2 - q0 * q3) + mz * (q1 * q3 + q0 * q2));
+            float hy = 2.0f * (mx * (q1 * q2 + q0 * q3) + my * (0.5f - q1 * q1 - q3 * q3) + mz * (q2 * q3 - q0 * q1));
+            float bx = sqrtf(hx * hx + hy * hy);
+            float bz = 2.0f * (mx * (q1 * q3 - q0 * q2) + my * (q2 * q3 + q0 * q1) + mz * (0.5f - q1 * q1 - q2 * q2));
+
+            // direction of the field estimated in body frame
+            float wx = bx * (0.5f - q2 * q2 - q3 * q3) + bz * (q1 * q3 - q0 * q2);
+            float wy = bx * (q1 * q2 - q0 * q3) + bz * (q0 * q1 + q2 * q3);
+            float wz = bx * (q0 * q2 + q1 * q3) + bz * (0.5f - q1 * q1 - q2 * q2);
+
+            ex += my * wz - mz * wy;
+            ey += mz * wx - mx * wz;
+            ez += mx * wy - my * wx;
+        }
+
+        if (ahrs->ki > 0) {
+            ahrs->integral.x += ahrs->ki * ex * dt;
+            ahrs->integral.y += ahrs->ki * ey * dt;
+            ahrs->integral.z += ahrs->ki * ez * dt;
+            gx += ahrs->integral.x;
+            gy += ahrs->integral.y;
+            gz += ahrs->integral.z;
+        }
+
+        gx += ahrs->kp * ex;
+        gy += ahrs->kp * ey;
+        gz += ahrs->kp * ez;
+    }
+
+    // integrate the rate of change of the quaternion, q' = 1/2 q * (0, g)
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    ahrs->q.w = q0 - q1 * gx - q2 * gy - q3 * gz;
+    ahrs->q.x = q1 + q0 * gx + q2 * gz - q3 * gy;
+    ahrs->q.y = q2 + q0 * gy - q1 * gz + q3 * gx;
+    ahrs->q.z = q3 + q0 * gz + q1 * gy - q2 * gx;
+
+    norm = 1.0f / sqrtf(ahrs->q.w * ahrs->q.w + ahrs->q.x * ahrs->q.x + ahrs->q.y * ahrs->q.y + ahrs->q.z * ahrs->q.z);
+    ahrs->q.w *= norm;
+    ahrs->q.x *= norm;
+    ahrs->q.y *= norm;
+    ahrs->q.z *= norm;
+
+    DB_PROFILE_END(_ahrs_update_probe);
+}
+
+float db_ahrs_heading(const ahrs_t *ahrs) {
+    const ahrs_quaternion_t *q = &ahrs->q;
+
+    float heading = atan2f(q->x * q->y + q->w * q->z, 0.5f - q->y * q->y - q->z * q->z);
+    if (heading < 0) {
+        heading += 2 * (float)M_PI;
+    }
+    return heading;
+}
+
+void db_ahrs_euler(const ahrs_t *ahrs, float *roll, float *pitch, float *heading) {
+    const ahrs_quaternion_t *q = &ahrs->q;
+
+    float sin_pitch = -2.0f * (q->x * q->z - q->w * q->y);
+    if (sin_pitch > 1.0f) {
+        sin_pitch = 1.0f;
+    } else if (sin_pitch < -1.0f) {
+        sin_pitch = -1.0f;
+    }
+
+    *roll    = atan2f(q->w * q->x + q->y * q->z, 0.5f - q->x * q->x - q->y * q->y);
+    *pitch   = asinf(sin_pitch);
+    *heading = db_ahrs_heading(ahrs);
+}
+
+//=========================== private ==========================================
+
+static inline float _ahrs_inv_norm(float x, float y, float z) {
+    float square = x * x + y * y + z * z;
+    return (square > 0) ? 1.0f / sqrtf(square) : 0;
+}
@@ -0,0 +1,93 @@
+#ifndef __FIXMATH_H
+#define __FIXMATH_H
+
+/**
+ * @file fixmath.h
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform declaration "fixmath" driver module.
+ *
+ * Integer math kernels for the navigation control loops: distance, atan2 and angle wrapping.
+ * They run in a bounded number of cycles, without float or double operations, so the timing
+ * of the control loops doesn't depend on the inputs or on the soft-float library.
+ *
+ * Angles are in centidegrees. Scale factors are given in Q16.16 fixed point format.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+#define DB_FIXMATH_Q16_SHIFT (16U)     ///< Number of fractional bits of the Q16.16 format
+#define DB_FIXMATH_180_CDEG  (18000L)  ///< Half turn, in centidegrees
+#define DB_FIXMATH_360_CDEG  (36000L)  ///< Full turn, in centidegrees
+
+/// Converts a constant to Q16.16 (evaluated at compile time when the argument is a constant)
+#define DB_FIXMATH_Q16(value) ((int32_t)((value) * (1L << DB_FIXMATH_Q16_SHIFT) + (((value) < 0) ? -0.5 : 0.5)))
+
+typedef int32_t fixmath_q16_t;  ///< Signed Q16.16 fixed point number
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief   Multiply an integer by a Q16.16 factor, the result is rounded to the nearest integer
+ *
+ * @param[in] value         Integer value
+ * @param[in] factor        Q16.16 factor
+ *
+ * @return the product, saturated to the int32_t range
+ */
+int32_t db_fixmath_mul_q16(int32_t value, fixmath_q16_t factor);
+
+/**
+ * @brief   Integer square root
+ *
+ * @param[in] value         Input value
+ *
+ * @return the square root of value, rounded down
+ */
+uint32_t db_fixmath_sqrt(uint64_t value);
+
+/**
+ * @brief   Euclidean norm of a 2D vector, the result has the same unit as the inputs
+ *
+ * @param[in] dx            X component
+ * @param[in] dy            Y component
+ *
+ * @return sqrt(dx^2 + dy^2), rounded down
+ */
+uint32_t db_fixmath_distance(int32_t dx, int32_t dy);
+
+/**
+ * @brief   Four quadrant arctangent of y/x (CORDIC, error below 0.01 degree)
+ *
+ * @param[in] y             Y component, any unit
+ * @param[in] x             X component, same unit as y
+ *
+ * @return the angle in centidegrees, from -18000 to 18000, 0 when both inputs are 0
+ */
+int32_t db_fixmath_atan2_cdeg(int32_t y, int32_t x);
+
+/**
+ * @brief   Wrap an angle to ]-18000, 18000] centidegrees
+ *
+ * @param[in] angle         Angle in centidegrees
+ *
+ * @return the equivalent angle in ]-18000, 18000]
+ */
+int32_t db_fixmath_wrap_180_cdeg(int32_t angle);
+
+/**
+ * @brief   Wrap an angle to [0, 36000[ centidegrees
+ *
+ * @param[in] angle         Angle in centidegrees
+ *
+ * @return the equivalent angle in [0, 36000[
+ */
+int32_t db_fixmath_wrap_360_cdeg(int32_t angle);
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file fixmath.c
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform implementation of the "fixmath" driver module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixmath.h"
+
+//=========================== defines ==========================================
+
+#define FIXMATH_CORDIC_ITERATIONS  (16U)  ///< Number of CORDIC iterations, the residual error is atan(2^-15)
+#define FIXMATH_CORDIC_ANGLE_SHIFT (8U)   ///< Fractional bits of the angles in the CORDIC table
+#define FIXMATH_CORDIC_INPUT_BITS  (29U)  ///< The inputs are normalized below 2^29 so the gain of the iterations can't overflow
+
+//=========================== variables ========================================
+
+/// atan(2^-i) in centidegrees, Q24.8
+static const int32_t _fixmath_cordic_atan[FIXMATH_CORDIC_ITERATIONS] = {
+    1152000, 680065, 359328, 182400, 91554, 45822, 22916, 11459,
+    5730, 2865, 1432, 716, 358, 179, 90, 45
+};
+
+//=========================== public ===========================================
+
+int32_t db_fixmath_mul_q16(int32_t value, fixmath_q16_t factor) {
+    int64_t product = ((int64_t)value * factor + (1L << (DB_FIXMATH_Q16_SHIFT - 1))) >> DB_FIXMATH_Q16_SHIFT;
+    if (product > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (product < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)product;
+}
+
+uint32_t db_fixmath_sqrt(uint64_t value) {
+    // Bit by bit method, at most 32 iterations
+    uint64_t result = 0;
+    uint64_t bit    = 1ULL << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
+
+uint32_t db_fixmath_distance(int32_t dx, int32_t dy) {
+    // each square is below 2^62, their sum can't overflow
+    int64_t x = dx;
+    int64_t y = dy;
+    return db_fixmath_sqrt((uint64_t)(x * x) + (uint64_t)(y * y));
+}
+
+int32_t db_fixmath_atan2_cdeg(int32_t y, int32_t x) {
+    if (x == 0 && y == 0) {
+        return 0;
+    }
+
+    // rotate the vector by 180 degrees in the right half plane, the CORDIC only converges there
+    int64_t x64    = x;
+    int64_t y64    = y;
+    int32_t offset = 0;
+    if (x64 < 0) {
+        x64    = -x64;
+        y64    = -y64;
+        offset = (y >= 0) ? DB_FIXMATH_180_CDEG : -DB_FIXMATH_180_CDEG;
+    }
+
+    // normalize the magnitude to [2^28, 2^29[ to keep the precision of small vectors
+    int64_t magnitude = (x64 > ((y64 < 0) ? -y64 : y64)) ? x64 : ((y64 < 0) ? -y64 : y64);
+    while (magnitude >= (1L << FIXMATH_CORDIC_INPUT_BITS)) {
+        magnitude >>= 1;
+        x64 >>= 1;
+        y64 >>= 1;
+    }
+    while (magnitude < (1L << (FIXMATH_CORDIC_INPUT_BITS - 1))) {
+        magnitude <<= 1;
+        x64 <<= 1;
+        y64 <<= 1;
+    }
+
+    // vectoring mode: rotate until y is 0, the angle is the sum of the rotations
+    int32_t vx    = (int32_t)x64;
+    int32_t vy    = (int32_t)y64;
+    int32_t angle = 0;
+    for (uint8_t i = 0; i < FIXMATH_CORDIC_ITERATIONS; i++) {
+        int32_t dx = vy >> i;
+        int32_t dy = vx >> i;
+        if (vy > 0) {
+            vx += dx;
+            vy -= dy;
+            angle += _fixmath_cordic_atan[i];
+        } else {
+            vx -= dx;
+            vy += dy;
+            angle -= _fixmath_cordic_atan[i];
+        }
+    }
+
+    angle = (angle + (1L << (FIXMATH_CORDIC_ANGLE_SHIFT - 1))) >> FIXMATH_CORDIC_ANGLE_SHIFT;
+    return db_fixmath_wrap_180_cdeg(angle + offset);
+}
+
+int32_t db_fixmath_wrap_180_cdeg(int32_t angle) {
+    angle %= DB_FIXMATH_360_CDEG;
+    if (angle > DB_FIXMATH_180_CDEG) {
+        angle -= DB_FIXMATH_360_CDEG;
+    } else if (angle <= -DB_FIXMATH_180_CDEG) {
+        angle += DB_FIXMATH_360_CDEG;
+    }
+    return angle;
+}
+
+int32_t db_fixmath_wrap_360_cdeg(int32_t angle) {
+    angle %= DB_FIXMATH_360_CDEG;
+    if (angle < 0) {
+        angle += DB_FIXMATH_360_CDEG;
+    }
+    return angle;
+}
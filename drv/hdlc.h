@@ -12,11 +12,14 @@
  * @copyright Inria, 2022
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 
 //=========================== definitions ======================================
 
+#define DB_HDLC_FCS_LENGTH (2U)  ///< Number of FCS bytes at the end of a decoded frame
+
 typedef enum {
     DB_HDLC_STATE_IDLE,       ///< Waiting for incoming HDLC frames
     DB_HDLC_STATE_RECEIVING,  ///< An HDLC frame is being received
@@ -24,10 +27,119 @@ typedef enum {
     DB_HDLC_STATE_ERROR,      ///< The FCS value is invalid
 } db_hdlc_state_t;
 
+typedef struct {
+    uint8_t        *output;       ///< Buffer where decoded bytes are written
+    size_t          output_size;  ///< Size of the output buffer
+    size_t          output_pos;   ///< Current position in the output buffer
+    db_hdlc_state_t state;        ///< Current state of the HDLC RX engine
+    uint16_t        fcs;          ///< Current value of the FCS
+    bool            escape;       ///< Whether the previous byte was an escape byte
+    bool            synced;       ///< Whether the previous byte was a flag
+} db_hdlc_t;
+
 //=========================== public ===========================================
 
 /**
- * @brief   Handle a byte received in HDLC internal state
+ * @brief   Initialize an HDLC RX context
+ *
+ * Each context decodes its own stream, so several links can be framed in parallel.
+ *
+ * @param[out]  hdlc        Pointer to the HDLC context
+ * @param[in]   buffer      Destination buffer of the decoded bytes
+ * @param[in]   size        Size of the destination buffer
+ */
+void db_hdlc_init(db_hdlc_t *hdlc, uint8_t *buffer, size_t size);
+
+/**
+ * @brief   Set the buffer where the next decoded frame is written
+ *
+ * The buffer must have room for the payload plus DB_HDLC_FCS_LENGTH bytes. A frame being
+ * received when this function is called is dropped.
+ *
+ * @param[in]   hdlc        Pointer to the HDLC context
+ * @param[in]   buffer      Destination buffer of the decoded bytes
+ * @param[in]   size        Size of the destination buffer
+ */
+void db_hdlc_ctx_rx_set_buffer(db_hdlc_t *hdlc, uint8_t *buffer, size_t size);
+
+/**
+ * @brief   Decode a chunk of received bytes
+ *
+ * Bytes are unescaped, checksummed and written to the destination buffer in a single pass.
+ * Decoding stops right after the end flag of a frame, so the caller must call this function
+ * again with the remaining bytes once the decoded frame is processed.
+ *
+ * @param[in]   hdlc        Pointer to the HDLC context
+ * @param[in]   input       Received bytes
+ * @param[in]   length      Number of received bytes
+ * @param[out]  consumed    Number of input bytes processed (can be NULL)
+ *
+ * @return the state of the HDLC RX engine after the last processed byte
+ */
+db_hdlc_state_t db_hdlc_ctx_rx_chunk(db_hdlc_t *hdlc, const uint8_t *input, size_t length, size_t *consumed);
+
+/**
+ * @brief   Length of the payload decoded in the destination buffer
+ *
+ * @param[in]   hdlc        Pointer to the HDLC context
+ *
+ * @return the payload length, without the FCS, or 0 if no valid frame is ready
+ */
+size_t db_hdlc_ctx_rx_payload_length(const db_hdlc_t *hdlc);
+
+/**
+ * @brief   Handle a byte received in an HDLC context
+ *
+ * @param[in]   hdlc        Pointer to the HDLC context
+ * @param[in]   byte        The received byte
+ */
+db_hdlc_state_t db_hdlc_ctx_rx_byte(db_hdlc_t *hdlc, uint8_t byte);
+
+/**
+ * @brief   Copy the frame decoded in an HDLC context
+ *
+ * @param[in]   hdlc        Pointer to the HDLC context
+ * @param[out]  output      Buffer where the payload is copied
+ *
+ * @return the number of bytes decoded, without the FCS
+ */
+size_t db_hdlc_ctx_decode(db_hdlc_t *hdlc, uint8_t *output);
+
+/**
+ * @brief   Set the buffer where the next decoded frame of the default context is written
+ *
+ * The buffer must have room for the payload plus DB_HDLC_FCS_LENGTH bytes. A frame being
+ * received when this function is called is dropped.
+ *
+ * @param[in]   buffer      Destination buffer of the decoded bytes
+ * @param[in]   size        Size of the destination buffer
+ */
+void db_hdlc_rx_set_buffer(uint8_t *buffer, size_t size);
+
+/**
+ * @brief   Decode a chunk of received bytes with the default context
+ *
+ * Bytes are unescaped, checksummed and written to the destination buffer in a single pass.
+ * Decoding stops right after the end flag of a frame, so the caller must call this function
+ * again with the remaining bytes once the decoded frame is processed.
+ *
+ * @param[in]   input       Received bytes
+ * @param[in]   length      Number of received bytes
+ * @param[out]  consumed    Number of input bytes processed (can be NULL)
+ *
+ * @return the state of the HDLC RX engine after the last processed byte
+ */
+db_hdlc_state_t db_hdlc_rx_chunk(const uint8_t *input, size_t length, size_t *consumed);
+
+/**
+ * @brief   Length of the payload decoded by the default context
+ *
+ * @return the payload length, without the FCS, or 0 if no valid frame is ready
+ */
+size_t db_hdlc_rx_payload_length(void);
+
+/**
+ * @brief   Handle a byte received in the default context
  *
  * @param[in]   byte    The received byte
  */
@@ -38,7 +150,7 @@ db_hdlc_state_t db_hdlc_rx_byte(uint8_t byte);
  *
  * @param[output]   payload     Decoded payload contained in the input buffer
  *
- * @return the number of bytes decoded
+ * @return the number of bytes decoded, without the FCS
  */
 size_t db_hdlc_decode(uint8_t *output);
 
@@ -7,10 +7,16 @@
  *
  * @brief  drv module for the ISM330DHCXTR IMU.
  *
+ * Besides single sample reads, the IMU can run in FIFO mode: the accelerometer and gyroscope
+ * samples are batched in the IMU FIFO and the watermark interrupt (INT1 pin) triggers the read of
+ * the whole batch in a single asynchronous I2C transaction (TWIM list mode). Each sample is
+ * timestamped with the high frequency timer.
+ *
  * @author Said Alvarado-Marin <said-alexander.alvarado-marin@inria.fr>
  *
  * @copyright Inria, 2023
  */
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <nrf.h>
@@ -37,6 +43,16 @@
 #define ISM330_REG_OUTZ_L_G 0x26
 #define ISM330_REG_OUTZ_H_G 0x27
 
+// FIFO Registers
+#define ISM330_REG_FIFO_CTRL1        0x07
+#define ISM330_REG_FIFO_CTRL2        0x08
+#define ISM330_REG_FIFO_CTRL3        0x09
+#define ISM330_REG_FIFO_CTRL4        0x0A
+#define ISM330_REG_INT1_CTRL         0x0D
+#define ISM330_REG_FIFO_STATUS1      0x3A
+#define ISM330_REG_FIFO_STATUS2      0x3B
+#define ISM330_REG_FIFO_DATA_OUT_TAG 0x78
+
 // Configuration Registers
 #define ISM330_REG_CTRL1_XL 0x10
 #define ISM330_REG_CTRL2_G  0x11
@@ -49,6 +65,42 @@
 #define ISM330_REG_CTRL9_XL 0x18
 #define ISM330_REG_CTRL10_C 0x19
 
+// Sensitivities of the raw values, for the ranges set by db_ism330_init
+#define ISM330_ACC_UG_PER_LSB    (122)    ///< +- 4g range, in ug/LSB
+#define ISM330_GYRO_UDPS_PER_LSB (17500)  ///< +- 500dps range, in udps/LSB
+
+#define ISM330_FIFO_BATCH_MAX (64U)  ///< Max number of samples read at once from the FIFO
+
+/// Output and FIFO batching data rates
+typedef enum {
+    DB_ISM330_ODR_12Hz5 = 0x1,  ///< 12.5 Hz
+    DB_ISM330_ODR_26Hz  = 0x2,  ///< 26 Hz
+    DB_ISM330_ODR_52Hz  = 0x3,  ///< 52 Hz
+    DB_ISM330_ODR_104Hz = 0x4,  ///< 104 Hz
+    DB_ISM330_ODR_208Hz = 0x5,  ///< 208 Hz
+    DB_ISM330_ODR_417Hz = 0x6,  ///< 417 Hz
+    DB_ISM330_ODR_833Hz = 0x7,  ///< 833 Hz
+    DB_ISM330_ODR_1k66  = 0x8,  ///< 1.66 kHz
+    DB_ISM330_ODR_3k33  = 0x9,  ///< 3.33 kHz
+    DB_ISM330_ODR_6k66  = 0xA,  ///< 6.66 kHz
+} db_ism330_odr_t;
+
+typedef enum {
+    DB_ISM330_SENSOR_GYRO  = 0x01,  ///< Gyroscope sample (FIFO tag)
+    DB_ISM330_SENSOR_ACCEL = 0x02,  ///< Accelerometer sample (FIFO tag)
+} db_ism330_sensor_t;
+
+/// Sample read from the FIFO, raw values (see ISM330_ACC_UG_PER_LSB and ISM330_GYRO_UDPS_PER_LSB)
+typedef struct {
+    uint32_t           timestamp;  ///< Time of the sample, in microseconds (db_timer_hf_now time base)
+    db_ism330_sensor_t sensor;     ///< Sensor that produced the sample
+    int16_t            x;          ///< X axis
+    int16_t            y;          ///< Y axis
+    int16_t            z;          ///< Z axis
+} db_ism330_sample_t;
+
+typedef void (*db_ism330_fifo_cb_t)(const db_ism330_sample_t *samples, size_t count);  ///< Called from interrupt context with each batch of samples
+
 //=========================== variables ========================================
 
 ///! Data type to store the accelerometer data in [cm/s^2]
@@ -76,6 +128,20 @@ typedef struct {
  */
 void db_ism330_init(const gpio_t *sda, const gpio_t *sck);
 
+/**
+ * @brief Switch the IMU to FIFO mode, the samples are then only available through the callback
+ *
+ * The accelerometer and the gyroscope both run at the given data rate. Samples are timestamped
+ * when the number of samples in the FIFO is read, the older samples of a batch are dated back
+ * using the data rate. After each batch the FIFO is read again until it is below the watermark.
+ *
+ * @param[in]   int1        pointer to gpio connected to the INT1 pin of the IMU, must stay valid
+ * @param[in]   odr         output and batching data rate of both sensors
+ * @param[in]   watermark   number of samples (accelerometer and gyroscope) that triggers a read, at most ISM330_FIFO_BATCH_MAX
+ * @param[in]   callback    function called with each batch of samples, from interrupt context
+ */
+void db_ism330_fifo_init(const gpio_t *int1, db_ism330_odr_t odr, uint16_t watermark, db_ism330_fifo_cb_t callback);
+
 /**
  * @brief Read the X, Y and Z values for the accelerometer.
  *        returned as a vector of 3 floats [x, y, z], in cm/s^2
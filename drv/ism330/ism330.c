@@ -19,6 +19,39 @@
 #include "i2c.h"
 #include "ism330.h"
 #include "math.h"
+#include "timer_hf.h"
+
+//=========================== defines ==========================================
+
+#define ISM330_FIFO_WORD_SIZE   (7U)     ///< Tag and 3 axes
+#define ISM330_CTRL3_C_BDU      (0x44)   ///< BDU[6] = 1 (block data update), IF_INC[2] = 1 (register address auto-increment)
+#define ISM330_FIFO_MODE_STREAM (0x06)   ///< FIFO_MODE[2:0] = 0b110 -> continuous mode, older samples are overwritten
+#define ISM330_INT1_FIFO_TH     (0x08)   ///< INT1_FIFO_TH[3] = 1 -> FIFO watermark on INT1 pin
+#define ISM330_DIFF_FIFO_MASK   (0x3FF)  ///< Number of unread words in the FIFO, in FIFO_STATUS1/2
+
+typedef struct {
+    db_ism330_fifo_cb_t  callback;                                             ///< Function called with each batch
+    const gpio_t        *int1;                                                 ///< INT1 pin, high while the FIFO is above the watermark
+    uint16_t             watermark;                                            ///< Number of words that triggers a read
+    uint32_t             period_us;                                            ///< Sampling period of both sensors
+    uint32_t             timestamp;                                            ///< Time the number of unread words was read
+    uint16_t             unread;                                               ///< Number of words newer than the batch, left in the FIFO
+    db_i2c_transaction_t status_transaction;                                   ///< Read of FIFO_STATUS1/2
+    db_i2c_transaction_t fifo_transaction;                                     ///< Read of the FIFO words
+    uint8_t              status[2];                                            ///< FIFO_STATUS1/2
+    uint8_t              fifo[ISM330_FIFO_BATCH_MAX * ISM330_FIFO_WORD_SIZE];  ///< FIFO words
+    db_ism330_sample_t   samples[ISM330_FIFO_BATCH_MAX];                       ///< Decoded samples, the newest at the end
+} ism330_fifo_vars_t;
+
+//=========================== variables ========================================
+
+static ism330_fifo_vars_t _ism330_fifo_vars;
+
+//=========================== prototypes =======================================
+
+static void _ism330_int1_handler(void *ctx);
+static void _ism330_status_read(db_i2c_transaction_t *transaction);
+static void _ism330_fifo_read(db_i2c_transaction_t *transaction);
 
 //=========================== public functions ================================
 
@@ -54,6 +87,53 @@ void db_ism330_init(const gpio_t *sda, const gpio_t *sck) {
     db_i2c_end();
 }
 
+void db_ism330_fifo_init(const gpio_t *int1, db_ism330_odr_t odr, uint16_t watermark, db_ism330_fifo_cb_t callback) {
+    assert(watermark > 0 && watermark <= ISM330_FIFO_BATCH_MAX);
+
+    db_timer_hf_init();
+    _ism330_fifo_vars.callback  = callback;
+    _ism330_fifo_vars.int1      = int1;
+    _ism330_fifo_vars.watermark = watermark;
+    _ism330_fifo_vars.period_us = (odr == DB_ISM330_ODR_12Hz5) ? 80000 : 1000000 / (26U << (odr - DB_ISM330_ODR_26Hz));
+
+    _ism330_fifo_vars.status_transaction.addr     = ISM330_ADDRESS;
+    _ism330_fifo_vars.status_transaction.reg      = ISM330_REG_FIFO_STATUS1;
+    _ism330_fifo_vars.status_transaction.data     = _ism330_fifo_vars.status;
+    _ism330_fifo_vars.status_transaction.length   = sizeof(_ism330_fifo_vars.status);
+    _ism330_fifo_vars.status_transaction.callback = _ism330_status_read;
+    _ism330_fifo_vars.status_transaction.status   = DB_I2C_STATUS_OK;
+
+    // FIFO words are read one by one, chained by the TWIM list mode
+    _ism330_fifo_vars.fifo_transaction.addr     = ISM330_ADDRESS;
+    _ism330_fifo_vars.fifo_transaction.reg      = ISM330_REG_FIFO_DATA_OUT_TAG;
+    _ism330_fifo_vars.fifo_transaction.data     = _ism330_fifo_vars.fifo;
+    _ism330_fifo_vars.fifo_transaction.length   = ISM330_FIFO_WORD_SIZE;
+    _ism330_fifo_vars.fifo_transaction.callback = _ism330_fifo_read;
+    _ism330_fifo_vars.fifo_transaction.status   = DB_I2C_STATUS_OK;
+
+    uint8_t ctrl[] = {
+        ISM330_CTRL3_C_BDU,
+        (uint8_t)((odr << 4) | 0b1000),  // ODR_XL[7:4] = odr, FS_XL [3:2] = 0b10 -> +- 4g
+        (uint8_t)((odr << 4) | 0b0100),  // ODR_G[7:4] = odr, FS_G [3:2] = 0b01 -> +-500dps
+        (uint8_t)(watermark & 0xFF),     // WTM[7:0]
+        (uint8_t)(watermark >> 8),       // WTM[8]
+        (uint8_t)((odr << 4) | odr),     // BDR_GY[7:4] = odr, BDR_XL[3:0] = odr
+        ISM330_FIFO_MODE_STREAM,
+        ISM330_INT1_FIFO_TH,
+    };
+
+    db_i2c_begin();
+    db_i2c_write_regs(ISM330_ADDRESS, ISM330_REG_CTRL3_C, &ctrl[0], 1);
+    db_i2c_write_regs(ISM330_ADDRESS, ISM330_REG_CTRL1_XL, &ctrl[1], 1);
+    db_i2c_write_regs(ISM330_ADDRESS, ISM330_REG_CTRL2_G, &ctrl[2], 1);
+    db_i2c_write_regs(ISM330_ADDRESS, ISM330_REG_FIFO_CTRL1, &ctrl[3], 4);  // FIFO_CTRL1 to FIFO_CTRL4
+    db_i2c_write_regs(ISM330_ADDRESS, ISM330_REG_INT1_CTRL, &ctrl[7], 1);
+
+    // INT1 stays high while the FIFO is above the watermark, only its rising edge triggers a read:
+    // the FIFO is drained until it is below the watermark so the next edge always comes
+    db_gpio_init_irq(int1, DB_GPIO_IN, DB_GPIO_IRQ_EDGE_RISING, _ism330_int1_handler, NULL);
+}
+
 void db_ism330_accel_read(ism330_acc_data_t *data) {
     uint8_t tmp[6];
     int16_t acc_x, acc_y, acc_z;
@@ -93,3 +173,89 @@ void db_ism330_gyro_read(ism330_gyro_data_t *data) {
     data->y = gyro_y * 17.5 / 1000.0 * M_PI / 180;
     data->z = gyro_z * 17.5 / 1000.0 * M_PI / 180;
 }
+
+//=========================== private ==========================================
+
+static void _ism330_int1_handler(void *ctx) {
+    (void)ctx;
+    // the watermark is reached, first get the number of words to read
+    if (_ism330_fifo_vars.status_transaction.status != DB_I2C_STATUS_PENDING && _ism330_fifo_vars.fifo_transaction.status != DB_I2C_STATUS_PENDING) {
+        db_i2c_submit(&_ism330_fifo_vars.status_transaction);
+    }
+}
+
+static void _ism330_status_read(db_i2c_transaction_t *transaction) {
+    // called from the TWIM interrupt
+    _ism330_fifo_vars.timestamp = db_timer_hf_now();
+    if (transaction->status != DB_I2C_STATUS_OK) {
+        return;
+    }
+
+    uint16_t words = (_ism330_fifo_vars.status[0] | (_ism330_fifo_vars.status[1] << 8)) & ISM330_DIFF_FIFO_MASK;
+    if (words < _ism330_fifo_vars.watermark) {
+        // INT1 is low, its next rising edge triggers the next read. If it rose while this read was
+        // pending, the edge was ignored by the handler, so check the pin level before waiting
+        if (db_gpio_read(_ism330_fifo_vars.int1)) {
+            db_i2c_submit(&_ism330_fifo_vars.status_transaction);
+        }
+        return;
+    }
+
+    // the oldest words are read first, the newer ones stay in the FIFO for the next batch
+    _ism330_fifo_vars.unread = 0;
+    if (words > ISM330_FIFO_BATCH_MAX) {
+        _ism330_fifo_vars.unread = words - ISM330_FIFO_BATCH_MAX;
+        words                    = ISM330_FIFO_BATCH_MAX;
+    }
+    _ism330_fifo_vars.fifo_transaction.count = (uint8_t)words;
+    db_i2c_submit(&_ism330_fifo_vars.fifo_transaction);
+}
+
+static void _ism330_fifo_read(db_i2c_transaction_t *transaction) {
+    // called from the TWIM interrupt
+    if (transaction->status != DB_I2C_STATUS_OK) {
+        return;
+    }
+
+    size_t  count = 0;
+    uint8_t words = transaction->count;
+
+    // number of newer samples of the same sensor
+    uint16_t newer[DB_ISM330_SENSOR_ACCEL + 1] = { 0 };
+
+    // both sensors batch at the same rate so their words alternate in the FIFO: the words left
+    // unread start with the other sensor than the newest word of the batch
+    for (uint8_t word = words; word > 0 && _ism330_fifo_vars.unread > 0; word--) {
+        uint8_t tag = _ism330_fifo_vars.fifo[(word - 1) * ISM330_FIFO_WORD_SIZE] >> 3;
+        if (tag == DB_ISM330_SENSOR_GYRO || tag == DB_ISM330_SENSOR_ACCEL) {
+            uint8_t other = (tag == DB_ISM330_SENSOR_GYRO) ? DB_ISM330_SENSOR_ACCEL : DB_ISM330_SENSOR_GYRO;
+            newer[tag]    = _ism330_fifo_vars.unread / 2;
+            newer[other]  = (_ism330_fifo_vars.unread + 1) / 2;
+            break;
+        }
+    }
+
+    // walk the batch from the newest word, samples of each sensor are evenly spaced by the sampling period
+    for (uint8_t word = words; word > 0; word--) {
+        const uint8_t *raw = &_ism330_fifo_vars.fifo[(word - 1) * ISM330_FIFO_WORD_SIZE];
+        uint8_t        tag = raw[0] >> 3;
+        if (tag != DB_ISM330_SENSOR_GYRO && tag != DB_ISM330_SENSOR_ACCEL) {
+            continue;
+        }
+        db_ism330_sample_t *sample = &_ism330_fifo_vars.samples[ISM330_FIFO_BATCH_MAX - 1 - count];
+        sample->sensor             = (db_ism330_sensor_t)tag;
+        sample->timestamp          = _ism330_fifo_vars.timestamp - newer[tag] * _ism330_fifo_vars.period_us;
+        sample->x                  = (int16_t)(raw[1] | (raw[2] << 8));
+        sample->y                  = (int16_t)(raw[3] | (raw[4] << 8));
+        sample->z                  = (int16_t)(raw[5] | (raw[6] << 8));
+        newer[tag]++;
+        count++;
+    }
+
+    if (_ism330_fifo_vars.callback && count > 0) {
+        _ism330_fifo_vars.callback(&_ism330_fifo_vars.samples[ISM330_FIFO_BATCH_MAX - count], count);
+    }
+
+    // INT1 won't rise again while the FIFO is above the watermark, check it after each batch
+    db_i2c_submit(&_ism330_fifo_vars.status_transaction);
+}
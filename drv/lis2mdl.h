@@ -7,6 +7,17 @@
  *
  * @brief  Module for controlling the IMU on the SailBot.
  *
+ * The magnetometer runs continuously at 100 Hz. On each data ready interrupt, the status and
+ * output registers are read in a single asynchronous I2C transaction and the heading is computed
+ * in fixed point, the callback is then called from interrupt context. The hard iron offset is
+ * removed by the sensor itself, using its offset registers.
+ *
+ * The offset can be calibrated on board: between lis2mdl_calibration_start and
+ * lis2mdl_calibration_stop, each sample updates a running least squares sphere fit (a few integer
+ * multiply-accumulates) while the board is rotated in all directions. The center of the sphere is
+ * the new offset. The fit is rejected when the samples don't cover enough of the sphere on each
+ * axis, e.g. when the board was only rotated around its vertical axis.
+ *
  * @author Mališa Vučinić <malisa.vucinic@inria.fr>
  *
  * @copyright Inria, 2022
@@ -25,10 +36,14 @@ typedef struct {
 
 typedef void (*lis2mdl_data_ready_cb_t)(void);  ///< Callback function prototype, it is called on each available sample
 
-void  lis2mdl_init(lis2mdl_data_ready_cb_t callback);
-bool  lis2mdl_data_ready(void);
-void  lis2mdl_read_heading(void);
-float lis2mdl_last_heading(void);
-void  lis2mdl_magnetometer_calibrate(lis2mdl_compass_data_t *offset);
+void     lis2mdl_init(lis2mdl_data_ready_cb_t callback);
+bool     lis2mdl_data_ready(void);
+void     lis2mdl_read_magnetometer(lis2mdl_compass_data_t *out);
+uint16_t lis2mdl_last_heading_cdeg(void);  ///< Last heading in centidegrees, from 0 to 35999 (north clockwise)
+float    lis2mdl_last_heading(void);       ///< Last heading in radians, from 0 to 2 PI (north clockwise)
+void     lis2mdl_set_offset(const lis2mdl_compass_data_t *offset);
+void     lis2mdl_calibration_start(void);                                             ///< Start accumulating samples for the hard iron calibration
+bool     lis2mdl_calibration_stop(lis2mdl_compass_data_t *offset, uint16_t *radius);  ///< Fit a sphere to the samples and write the new offset, false if the fit failed
+void     lis2mdl_magnetometer_calibrate(lis2mdl_compass_data_t *offset);
 
 #endif
@@ -10,7 +10,9 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "fixmath.h"
 #include "gpio.h"
 #include "i2c.h"
 #include "lis2mdl.h"
@@ -45,17 +47,43 @@ static const gpio_t mag_int = { .port = 0, .pin = 17 };
 
 #define LIS2MDL_WHO_AM_I_VAL (0x40)
 
+#define LIS2MDL_CFG_REG_A_VAL (0x8C)  ///< temperature compensation, high resolution, 100 Hz, continuous mode
+#define LIS2MDL_CFG_REG_B_VAL (0x02)  ///< offset cancellation in continuous mode
+#define LIS2MDL_CFG_REG_C_VAL (0x01)  ///< DRDY_on_PIN
+
+#define LIS2MDL_STATUS_ZYXDA (0x08)  ///< new X, Y and Z data available
+
+#define LIS2MDL_BURST_LENGTH (7U)  ///< STATUS_REG to OUTZ_H_REG, read at once with the register address auto-increment
+
+#define LIS2MDL_CALIBRATION_SAMPLES     (3000U)   ///< 30 s at 100 Hz, rotate the board in all directions meanwhile
+#define LIS2MDL_CALIBRATION_SAMPLES_MIN (200U)    ///< Samples needed for a fit
+#define LIS2MDL_CALIBRATION_SAMPLES_MAX (60000U)  ///< 10 min at 100 Hz, keeps the sums far from overflowing
+#define LIS2MDL_CALIBRATION_PARAMS      (4U)      ///< Parameters of the sphere fit
+#define LIS2MDL_CALIBRATION_AXES        (3U)      ///< Coordinates of the center, solved once the samples are centered
+#define LIS2MDL_CALIBRATION_PIVOT_MIN   (0.05f)   ///< Min ratio between a pivot and the largest variance, rejects samples close to a plane
+#define LIS2MDL_CALIBRATION_SPREAD_MIN  (0.15f)   ///< Min standard deviation of the samples on each axis, relative to the radius
+
 #define SAILBOT_REV10_OFFSET_X (-273)
 #define SAILBOT_REV10_OFFSET_Y (160)
 #define SAILBOT_REV10_OFFSET_Z (367)
 
-// 1 / 6842, where 6842 is sensitivy from the datasheet
-#define LIS2MDL_SENSITIVITY 1.5f
+/// Running least squares sphere fit, |m|^2 = 2 c.m + (r^2 - |c|^2) is linear in (2 c, r^2 - |c|^2)
+typedef struct {
+    bool     running;                                                         ///< Whether samples are accumulated
+    uint32_t count;                                                           ///< Number of samples accumulated
+    int64_t  normal[LIS2MDL_CALIBRATION_PARAMS][LIS2MDL_CALIBRATION_PARAMS];  ///< Sum of (x, y, z, 1)^T (x, y, z, 1), upper triangle only
+    int64_t  rhs[LIS2MDL_CALIBRATION_PARAMS];                                 ///< Sum of (x, y, z, 1)^T |m|^2
+} lis2mdl_calibration_t;
 
 typedef struct {
-    lis2mdl_data_ready_cb_t callback;
-    bool                    data_ready;
-    float                   heading;
+    lis2mdl_data_ready_cb_t callback;                      ///< Function called when a new sample is available
+    db_i2c_transaction_t    transaction;                   ///< Burst read of the status and output registers
+    uint8_t                 buffer[LIS2MDL_BURST_LENGTH];  ///< Status and output registers
+    lis2mdl_compass_data_t  data;                          ///< Last sample (hard iron offset already removed)
+    uint16_t                heading;                       ///< Last heading, in centidegrees
+    volatile bool           data_ready;                    ///< Whether a sample was received since the last call to lis2mdl_read_magnetometer
+    lis2mdl_compass_data_t  offset;                        ///< Hard iron offset written in the offset registers
+    lis2mdl_calibration_t   calibration;                   ///< Sphere fit state
 } lis2mdl_vars_t;
 
 //=========================== variables ========================================
@@ -64,7 +92,9 @@ static lis2mdl_vars_t _lis2mdl_vars;
 
 //=========================== prototypes ========================================
 
-void lis2mdl_i2c_read_magnetometer(lis2mdl_compass_data_t *out);
+static void _lis2mdl_read_done(db_i2c_transaction_t *transaction);
+static void _lis2mdl_calibration_add(const lis2mdl_compass_data_t *sample);
+static bool _lis2mdl_solve(float matrix[LIS2MDL_CALIBRATION_AXES][LIS2MDL_CALIBRATION_AXES + 1], float *solution);
 
 //============================== public ========================================
 
@@ -72,24 +102,34 @@ void lis2mdl_init(lis2mdl_data_ready_cb_t callback) {
     uint8_t who_am_i;
     uint8_t tmp;
 
-    _lis2mdl_vars.callback = callback;
+    _lis2mdl_vars.callback             = callback;
+    _lis2mdl_vars.transaction.addr     = LIS2MDL_ADDR;
+    _lis2mdl_vars.transaction.reg      = LIS2MDL_STATUS_REG;
+    _lis2mdl_vars.transaction.data     = _lis2mdl_vars.buffer;
+    _lis2mdl_vars.transaction.length   = LIS2MDL_BURST_LENGTH;
+    _lis2mdl_vars.transaction.callback = _lis2mdl_read_done;
+    _lis2mdl_vars.transaction.status   = DB_I2C_STATUS_OK;
 
     db_i2c_init(&scl, &sda);
     db_i2c_begin();
     db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_WHO_AM_I_REG, &who_am_i, 1);
     assert(who_am_i == LIS2MDL_WHO_AM_I_VAL);
 
-    // set continous mode, output data rate at 10 Hz
-    tmp = 0x00;
+    // set continous mode, output data rate at 100 Hz
+    tmp = LIS2MDL_CFG_REG_A_VAL;
     db_i2c_write_regs(LIS2MDL_ADDR, LIS2MDL_CFG_REG_A_REG, &tmp, 1);
-    // keep default values of REG_B
-    tmp = 0x00;
+    tmp = LIS2MDL_CFG_REG_B_VAL;
     db_i2c_write_regs(LIS2MDL_ADDR, LIS2MDL_CFG_REG_B_REG, &tmp, 1);
-    // set DRDY_on_PIN bit
-    tmp = 0x01;
+    tmp = LIS2MDL_CFG_REG_C_VAL;
     db_i2c_write_regs(LIS2MDL_ADDR, LIS2MDL_CFG_REG_C_REG, &tmp, 1);
 
-    db_i2c_end();
+    // the hard iron offset is removed by the sensor itself
+    const lis2mdl_compass_data_t offset = {
+        .x = SAILBOT_REV10_OFFSET_X,
+        .y = SAILBOT_REV10_OFFSET_Y,
+        .z = SAILBOT_REV10_OFFSET_Z,
+    };
+    lis2mdl_set_offset(&offset);
 
     // Configure DATARDY GPIO as input and generate an interrupt on rising edge
     NRF_P0->PIN_CNF[mag_int.pin] = (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) |        // Set Pin as input
@@ -106,84 +146,221 @@ void lis2mdl_init(lis2mdl_data_ready_cb_t callback) {
 
     NVIC_EnableIRQ(GPIOTE_IRQn);
     NVIC_ClearPendingIRQ(GPIOTE_IRQn);
+
+    // DRDY may already be high, it only goes low once the output registers are read
+    db_i2c_submit(&_lis2mdl_vars.transaction);
 }
 
-// function should be invoked only upon DATA RDY interrupt, outside of the interrupt context
-void lis2mdl_i2c_read_magnetometer(lis2mdl_compass_data_t *out) {
-    uint8_t tmp;
+void lis2mdl_set_offset(const lis2mdl_compass_data_t *offset) {
+    // OFFSET_X_REG_L to OFFSET_Z_REG_H, little endian, same unit as the output registers
+    uint8_t registers[6];
+    memcpy(&registers[0], &offset->x, sizeof(int16_t));
+    memcpy(&registers[2], &offset->y, sizeof(int16_t));
+    memcpy(&registers[4], &offset->z, sizeof(int16_t));
+    db_i2c_write_regs(LIS2MDL_ADDR, LIS2MDL_OFFSET_X_REG_L, registers, sizeof(registers));
+    _lis2mdl_vars.offset = *offset;
+}
 
-    db_i2c_begin();
+void lis2mdl_calibration_start(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&_lis2mdl_vars.calibration, 0, sizeof(_lis2mdl_vars.calibration));
+    _lis2mdl_vars.calibration.running = true;
+    __set_PRIMASK(primask);
+}
 
-    // make sure that data is ready for read
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_STATUS_REG, &tmp, 1);
+bool lis2mdl_calibration_stop(lis2mdl_compass_data_t *offset, uint16_t *radius) {
+    float matrix[LIS2MDL_CALIBRATION_AXES][LIS2MDL_CALIBRATION_AXES + 1];
+    float mean[LIS2MDL_CALIBRATION_AXES];
+    float variance[LIS2MDL_CALIBRATION_AXES];
+    float center[LIS2MDL_CALIBRATION_AXES];
+
+    // samples are accumulated from the TWIM interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _lis2mdl_vars.calibration.running = false;
+    lis2mdl_calibration_t calibration = _lis2mdl_vars.calibration;
+    __set_PRIMASK(primask);
+
+    if (calibration.count < LIS2MDL_CALIBRATION_SAMPLES_MIN) {
+        return false;
+    }
 
-    if ((tmp & 0x8) == 0) {
-        return;
+    // The fit is solved around the mean of the samples, u = m - mean: the sums are scaled down to
+    // moments that float represents without cancellation. As sum(u) = 0, the constant term drops
+    // out and the center c' (relative to the mean) solves cov(u) c' = sum(u |u|^2) / (2 n), with
+    // sum(u |u|^2) / n = E[m |m|^2] - mean E[|m|^2] - 2 cov(u) mean
+    float count  = (float)calibration.count;
+    float norm_2 = (float)calibration.rhs[LIS2MDL_CALIBRATION_AXES] / count;
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        mean[row] = (float)calibration.normal[row][LIS2MDL_CALIBRATION_AXES] / count;
+    }
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        for (uint8_t col = row; col < LIS2MDL_CALIBRATION_AXES; col++) {
+            matrix[row][col] = (float)calibration.normal[row][col] / count - mean[row] * mean[col];
+            matrix[col][row] = matrix[row][col];
+        }
+    }
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        float rhs = (float)calibration.rhs[row] / count - mean[row] * norm_2;
+        for (uint8_t col = 0; col < LIS2MDL_CALIBRATION_AXES; col++) {
+            rhs -= 2 * matrix[row][col] * mean[col];
+        }
+        matrix[row][LIS2MDL_CALIBRATION_AXES] = rhs / 2;
+        variance[row]                         = matrix[row][row];
     }
 
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTX_L_REG, &tmp, 1);
-    out->x = (int16_t)tmp;
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTX_H_REG, &tmp, 1);
-    out->x |= (int16_t)tmp << 8;
+    if (!_lis2mdl_solve(matrix, center)) {
+        return false;
+    }
 
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTY_L_REG, &tmp, 1);
-    out->y = (int16_t)tmp;
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTY_H_REG, &tmp, 1);
-    out->y |= (int16_t)tmp << 8;
+    // the samples are on the sphere: r^2 = E[|u - c'|^2] = E[|u|^2] + |c'|^2
+    float radius_2 = 0;
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        radius_2 += variance[row] + center[row] * center[row];
+    }
+    // with a yaw only rotation (e.g. with some heel), an axis barely changes and its center is a guess
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        if (variance[row] < LIS2MDL_CALIBRATION_SPREAD_MIN * LIS2MDL_CALIBRATION_SPREAD_MIN * radius_2) {
+            return false;
+        }
+    }
 
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTZ_L_REG, &tmp, 1);
-    out->z = (int16_t)tmp;
-    db_i2c_read_regs(LIS2MDL_ADDR, LIS2MDL_OUTZ_H_REG, &tmp, 1);
-    out->z |= (int16_t)tmp << 8;
-    db_i2c_end();
+    // the samples were measured with the previous offset removed, the center is relative to it
+    offset->x = (int16_t)lroundf(_lis2mdl_vars.offset.x + mean[0] + center[0]);
+    offset->y = (int16_t)lroundf(_lis2mdl_vars.offset.y + mean[1] + center[1]);
+    offset->z = (int16_t)lroundf(_lis2mdl_vars.offset.z + mean[2] + center[2]);
+    if (radius) {
+        *radius = (uint16_t)lroundf(sqrtf(radius_2));
+    }
+    lis2mdl_set_offset(offset);
+    return true;
+}
 
+void lis2mdl_read_magnetometer(lis2mdl_compass_data_t *out) {
+    // the sample is updated from the TWIM interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out                     = _lis2mdl_vars.data;
     _lis2mdl_vars.data_ready = false;
+    __set_PRIMASK(primask);
 }
 
 void lis2mdl_magnetometer_calibrate(lis2mdl_compass_data_t *offset) {
-    (void)offset;
     lis2mdl_compass_data_t current;
 
     printf("X,Y,Z\n");
 
-    // loop forever
-    while (1) {
-
-        // save max and min values
-        if (lis2mdl_data_ready()) {
-            lis2mdl_i2c_read_magnetometer(&current);
-            printf("%d,%d,%d\n", current.x, current.y, current.z);
+    lis2mdl_calibration_start();
+    for (uint32_t sample = 0; sample < LIS2MDL_CALIBRATION_SAMPLES;) {
+        if (!lis2mdl_data_ready()) {
+            __WFE();
+            continue;
         }
-        __WFE();
+        lis2mdl_read_magnetometer(&current);
+        printf("%d,%d,%d\n", current.x, current.y, current.z);
+        sample++;
     }
 
-    return;
+    if (!lis2mdl_calibration_stop(offset, NULL)) {
+        *offset = _lis2mdl_vars.offset;
+    }
+}
+
+uint16_t lis2mdl_last_heading_cdeg(void) {
+    return _lis2mdl_vars.heading;
+}
+
+float lis2mdl_last_heading(void) {
+    return (float)_lis2mdl_vars.heading * (float)M_PI / 18000;
+}
+
+bool lis2mdl_data_ready(void) {
+    return _lis2mdl_vars.data_ready;
 }
 
-void lis2mdl_read_heading(void) {
-    lis2mdl_compass_data_t raw_data;
-    float                  x;
-    float                  y;
+//============================== private =======================================
 
-    lis2mdl_i2c_read_magnetometer(&raw_data);
+static void _lis2mdl_read_done(db_i2c_transaction_t *transaction) {
+    // called from the TWIM interrupt
+    if (transaction->status != DB_I2C_STATUS_OK || (_lis2mdl_vars.buffer[0] & LIS2MDL_STATUS_ZYXDA) == 0) {
+        return;
+    }
 
-    // convert to heading
+    _lis2mdl_vars.data.x = (int16_t)(_lis2mdl_vars.buffer[1] | (_lis2mdl_vars.buffer[2] << 8));
+    _lis2mdl_vars.data.y = (int16_t)(_lis2mdl_vars.buffer[3] | (_lis2mdl_vars.buffer[4] << 8));
+    _lis2mdl_vars.data.z = (int16_t)(_lis2mdl_vars.buffer[5] | (_lis2mdl_vars.buffer[6] << 8));
 
-    // convert raw data to uT and account for offset
-    x = (float)(raw_data.x - SAILBOT_REV10_OFFSET_X) * LIS2MDL_SENSITIVITY;
-    y = (float)(raw_data.y - SAILBOT_REV10_OFFSET_Y) * LIS2MDL_SENSITIVITY;
+    // atan2(x,y) for north-clockwise convention, + 180 degrees for 0 to 360 degrees heading
+    int32_t heading = db_fixmath_wrap_360_cdeg(db_fixmath_atan2_cdeg(_lis2mdl_vars.data.x, _lis2mdl_vars.data.y) + DB_FIXMATH_180_CDEG);
+    _lis2mdl_vars.heading    = (uint16_t)heading;
+    _lis2mdl_vars.data_ready = true;
+
+    if (_lis2mdl_vars.calibration.running) {
+        _lis2mdl_calibration_add(&_lis2mdl_vars.data);
+    }
 
-    // atan2(x,y) for north-clockwise convention, + Pi for 0 to 2PI heading
-    _lis2mdl_vars.heading = atan2f(x, y) + M_PI;
-    return;
+    // invoke application callback if initialized
+    if (_lis2mdl_vars.callback != NULL) {
+        _lis2mdl_vars.callback();
+    }
 }
 
-float lis2mdl_last_heading(void) {
-    return _lis2mdl_vars.heading;
+static void _lis2mdl_calibration_add(const lis2mdl_compass_data_t *sample) {
+    lis2mdl_calibration_t *calibration = &_lis2mdl_vars.calibration;
+    if (calibration->count >= LIS2MDL_CALIBRATION_SAMPLES_MAX) {
+        return;
+    }
+
+    const int64_t regressors[LIS2MDL_CALIBRATION_PARAMS] = { sample->x, sample->y, sample->z, 1 };
+    int64_t       norm_2                                 = regressors[0] * regressors[0] + regressors[1] * regressors[1] + regressors[2] * regressors[2];
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_PARAMS; row++) {
+        for (uint8_t col = row; col < LIS2MDL_CALIBRATION_PARAMS; col++) {
+            calibration->normal[row][col] += regressors[row] * regressors[col];
+        }
+        calibration->rhs[row] += regressors[row] * norm_2;
+    }
+    calibration->count++;
 }
 
-bool lis2mdl_data_ready(void) {
-    return _lis2mdl_vars.data_ready;
+static bool _lis2mdl_solve(float matrix[LIS2MDL_CALIBRATION_AXES][LIS2MDL_CALIBRATION_AXES + 1], float *solution) {
+    float scale = 0;
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        scale = fmaxf(scale, fabsf(matrix[row][row]));
+    }
+
+    // Gauss-Jordan elimination with partial pivoting on the augmented matrix
+    for (uint8_t col = 0; col < LIS2MDL_CALIBRATION_AXES; col++) {
+        uint8_t pivot = col;
+        for (uint8_t row = col + 1; row < LIS2MDL_CALIBRATION_AXES; row++) {
+            if (fabsf(matrix[row][col]) > fabsf(matrix[pivot][col])) {
+                pivot = row;
+            }
+        }
+        // the pivots are the variances left once the previous axes are known: a small one means
+        // the samples are close to a plane (e.g. the board was only rotated around one axis)
+        if (fabsf(matrix[pivot][col]) < LIS2MDL_CALIBRATION_PIVOT_MIN * scale) {
+            return false;
+        }
+        for (uint8_t index = 0; index <= LIS2MDL_CALIBRATION_AXES; index++) {
+            float tmp            = matrix[col][index];
+            matrix[col][index]   = matrix[pivot][index];
+            matrix[pivot][index] = tmp;
+        }
+        for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+            if (row == col) {
+                continue;
+            }
+            float factor = matrix[row][col] / matrix[col][col];
+            for (uint8_t index = col; index <= LIS2MDL_CALIBRATION_AXES; index++) {
+                matrix[row][index] -= factor * matrix[col][index];
+            }
+        }
+    }
+    for (uint8_t row = 0; row < LIS2MDL_CALIBRATION_AXES; row++) {
+        solution[row] = matrix[row][LIS2MDL_CALIBRATION_AXES] / matrix[row][row];
+    }
+    return true;
 }
 
 //============================== interrupts ====================================
@@ -194,13 +371,9 @@ void GPIOTE_IRQHandler(void) {
 
     if (NRF_GPIOTE->EVENTS_PORT) {
         NRF_GPIOTE->EVENTS_PORT = 0;
-        if (pins & GPIO_IN_PIN17_Msk) {  // if pin 17 is high, data is ready
-            // set data_ready to true
-            _lis2mdl_vars.data_ready = true;
-            // invoke application callback if initialized
-            if (_lis2mdl_vars.callback != NULL) {
-                _lis2mdl_vars.callback();
-            }
+        // if pin 17 is high, data is ready, read the status and output registers at once (unless the previous read is still running)
+        if ((pins & GPIO_IN_PIN17_Msk) && _lis2mdl_vars.transaction.status != DB_I2C_STATUS_PENDING) {
+            db_i2c_submit(&_lis2mdl_vars.transaction);
         }
     }
 }
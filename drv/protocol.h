@@ -16,24 +16,33 @@
 
 //=========================== defines ==========================================
 
-#define DB_FIRMWARE_VERSION  (7)                   ///< Version of the firmware
+#define DB_FIRMWARE_VERSION  (8)                   ///< Version of the firmware
 #define DB_SWARM_ID          (0x0000)              ///< Default swarm ID
 #define DB_BROADCAST_ADDRESS 0xffffffffffffffffUL  ///< Broadcast address
 #define DB_GATEWAY_ADDRESS   0x0000000000000000UL  ///< Gateway address
 #define DB_MAX_WAYPOINTS     (16)                  ///< Max number of waypoints
 
 typedef enum {
-    DB_PROTOCOL_CMD_MOVE_RAW  = 0,   ///< Move raw command type
-    DB_PROTOCOL_CMD_RGB_LED   = 1,   ///< RGB LED command type
-    DB_PROTOCOL_LH2_RAW_DATA  = 2,   ///< Lighthouse 2 raw data
-    DB_PROTOCOL_LH2_LOCATION  = 3,   ///< Lighthouse processed locations
-    DB_PROTOCOL_ADVERTISEMENT = 4,   ///< DotBot advertisements
-    DB_PROTOCOL_GPS_LOCATION  = 5,   ///< GPS data from SailBot
-    DB_PROTOCOL_DOTBOT_DATA   = 6,   ///< DotBot specific data (for now location and direction)
-    DB_PROTOCOL_CONTROL_MODE  = 7,   ///< Robot remote control mode (automatic or manual)
-    DB_PROTOCOL_LH2_WAYPOINTS = 8,   ///< List of LH2 waypoints to follow
-    DB_PROTOCOL_GPS_WAYPOINTS = 9,   ///< List of GPS waypoints to follow
-    DB_PROTOCOL_SAILBOT_DATA  = 10,  ///< SailBot specific data (for now GPS and direction)
+    DB_PROTOCOL_CMD_MOVE_RAW   = 0,   ///< Move raw command type
+    DB_PROTOCOL_CMD_RGB_LED    = 1,   ///< RGB LED command type
+    DB_PROTOCOL_LH2_RAW_DATA   = 2,   ///< Lighthouse 2 raw data
+    DB_PROTOCOL_LH2_LOCATION   = 3,   ///< Lighthouse processed locations
+    DB_PROTOCOL_ADVERTISEMENT  = 4,   ///< DotBot advertisements
+    DB_PROTOCOL_GPS_LOCATION   = 5,   ///< GPS data from SailBot
+    DB_PROTOCOL_DOTBOT_DATA    = 6,   ///< DotBot specific data (for now location and direction)
+    DB_PROTOCOL_CONTROL_MODE   = 7,   ///< Robot remote control mode (automatic or manual)
+    DB_PROTOCOL_LH2_WAYPOINTS  = 8,   ///< List of LH2 waypoints to follow
+    DB_PROTOCOL_GPS_WAYPOINTS  = 9,   ///< List of GPS waypoints to follow
+    DB_PROTOCOL_SAILBOT_DATA   = 10,  ///< SailBot specific data (for now GPS and direction)
+    DB_PROTOCOL_SNAPSHOT       = 11,  ///< Latest data of several robots, coalesced by the gateway
+    DB_PROTOCOL_ECHO_REQUEST   = 12,  ///< Echo request, reflected by the robots
+    DB_PROTOCOL_ECHO_REPLY     = 13,  ///< Reply to an echo request
+    DB_PROTOCOL_PROFILE_REQ    = 14,  ///< Request for the profiling probes results
+    DB_PROTOCOL_PROFILE_DATA   = 15,  ///< Profiling probes results (see profile.h for the format)
+    DB_PROTOCOL_LOG            = 16,  ///< Binary log records (see log.h for the format)
+    DB_PROTOCOL_MAG_CAL_REQ    = 17,  ///< Start or stop the on board magnetometer calibration
+    DB_PROTOCOL_MAG_CAL_DATA   = 18,  ///< Result of the on board magnetometer calibration
+    DB_PROTOCOL_DOWNLINK_DROPS = 19,  ///< Packets from the host dropped by the gateway because its queue was full
 } command_type_t;
 
 typedef enum {
@@ -89,6 +98,47 @@ typedef struct __attribute__((packed)) {
     protocol_gps_coordinate_t coordinates[DB_MAX_WAYPOINTS];  ///< Array containing a list of GPS coordinates
 } protocol_gps_waypoints_t;
 
+/// A snapshot is made of the number of entries (1 byte) followed by the entries, each one followed by the robot packet
+typedef struct __attribute__((packed)) {
+    uint16_t age_ms;  ///< Time elapsed since the packet was received, in ms
+    int8_t   rssi;    ///< RSSI of the packet, in dBm
+    uint8_t  length;  ///< Length of the packet following this entry
+} protocol_snapshot_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t id;               ///< Identifier chosen by the sender, reflected unchanged
+    uint32_t tx_timestamp_us;  ///< Gateway time when the request was sent over radio, in us
+} protocol_echo_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t reset;  ///< Whether the probes are reset once reported
+} protocol_profile_request_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t start;  ///< 1 to start collecting samples, 0 to stop and apply the result
+} protocol_mag_cal_request_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  valid;   ///< Whether the fit succeeded, the offset is unchanged otherwise
+    int16_t  x;       ///< Offset applied on X axis, in LSB
+    int16_t  y;       ///< Offset applied on Y axis, in LSB
+    int16_t  z;       ///< Offset applied on Z axis, in LSB
+    uint16_t radius;  ///< Radius of the fitted sphere (field strength), in LSB
+} protocol_mag_cal_data_t;
+
+/// Counters since the gateway startup, sent to the host when one of them changes
+typedef struct __attribute__((packed)) {
+    uint32_t safety;   ///< Stop commands dropped
+    uint32_t control;  ///< Move, LED, control mode commands and echo requests dropped
+    uint32_t bulk;     ///< Other packets dropped
+} protocol_downlink_drops_t;
+
+/// Each frame sent by the gateway to the host starts with this envelope
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_us;  ///< Gateway time when the packet was received over radio, in us
+    int8_t   rssi;          ///< RSSI of the packet, in dBm (0 for packets generated by the gateway)
+} protocol_gateway_envelope_t;
+
 //=========================== public ===========================================
 
 /**
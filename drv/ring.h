@@ -0,0 +1,149 @@
+#ifndef __RING_H
+#define __RING_H
+
+/**
+ * @file ring.h
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform declaration "ring" driver module.
+ *
+ * Lock-free single producer/single consumer ring buffer. The producer and the consumer can run
+ * in different contexts (interrupt and thread mode) without critical section, as long as there
+ * is only one of each.
+ *
+ * A ring is used either as a byte stream (db_ring_write/db_ring_read_span/db_ring_consume) or as
+ * a queue of variable length records (db_ring_push/db_ring_peek/db_ring_pop), never both.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//=========================== defines ==========================================
+
+#define DB_RING_RECORD_HEADER_SIZE (4U)  ///< Bytes used by the header of a record (records are 4 bytes aligned)
+
+/// Checks at compile time that a ring size is a power of 2
+#define DB_RING_CHECK_SIZE(size) _Static_assert(((size) > 0) && (((size) & ((size)-1)) == 0), "ring size must be a power of 2")
+
+/// Number of bytes used in a ring by a record of the given length
+#define DB_RING_RECORD_SIZE(length) (DB_RING_RECORD_HEADER_SIZE + (((length) + 3U) & ~3U))
+
+typedef struct {
+    uint8_t          *buffer;      ///< Storage of the ring
+    uint32_t          size;        ///< Size of the storage (must be a power of 2)
+    volatile uint32_t head;        ///< Free running write index, only modified by the producer
+    volatile uint32_t tail;        ///< Free running read index, only modified by the consumer
+    uint32_t          dropped;     ///< Number of bytes (stream) or records dropped because the ring was full
+    uint32_t          high_water;  ///< Maximum number of bytes used since initialization
+} db_ring_t;
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief   Initialize a ring buffer
+ *
+ * @param[out]  ring        Pointer to the ring
+ * @param[in]   buffer      Storage of the ring
+ * @param[in]   size        Size of the storage, must be a power of 2
+ */
+void db_ring_init(db_ring_t *ring, uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief   Number of bytes used in the ring
+ *
+ * @param[in]   ring        Pointer to the ring
+ *
+ * @return the number of bytes used
+ */
+uint32_t db_ring_used(const db_ring_t *ring);
+
+/**
+ * @brief   Number of bytes free in the ring
+ *
+ * @param[in]   ring        Pointer to the ring
+ *
+ * @return the number of bytes free
+ */
+uint32_t db_ring_free(const db_ring_t *ring);
+
+/**
+ * @brief   Whether the ring is empty
+ *
+ * @param[in]   ring        Pointer to the ring
+ */
+bool db_ring_is_empty(const db_ring_t *ring);
+
+/**
+ * @brief   Whether the ring is full
+ *
+ * @param[in]   ring        Pointer to the ring
+ */
+bool db_ring_is_full(const db_ring_t *ring);
+
+/**
+ * @brief   Write bytes in a stream ring (producer side)
+ *
+ * Bytes that don't fit in the ring are dropped and counted.
+ *
+ * @param[in]   ring        Pointer to the ring
+ * @param[in]   data        Bytes to write
+ * @param[in]   length      Number of bytes to write
+ *
+ * @return the number of bytes written
+ */
+size_t db_ring_write(db_ring_t *ring, const uint8_t *data, size_t length);
+
+/**
+ * @brief   Get the contiguous bytes available in a stream ring (consumer side)
+ *
+ * @param[in]   ring        Pointer to the ring
+ * @param[out]  data        Pointer to the first available byte
+ *
+ * @return the number of contiguous bytes available, 0 if the ring is empty
+ */
+size_t db_ring_read_span(const db_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief   Release bytes read from a stream ring (consumer side)
+ *
+ * @param[in]   ring        Pointer to the ring
+ * @param[in]   length      Number of bytes to release
+ */
+void db_ring_consume(db_ring_t *ring, size_t length);
+
+/**
+ * @brief   Push a record in a record ring (producer side)
+ *
+ * Records are stored contiguously, either the whole record is pushed or it is dropped and counted.
+ *
+ * @param[in]   ring        Pointer to the ring
+ * @param[in]   data        Content of the record
+ * @param[in]   length      Length of the record
+ *
+ * @return true if the record was pushed, false if the ring is full
+ */
+bool db_ring_push(db_ring_t *ring, const uint8_t *data, size_t length);
+
+/**
+ * @brief   Get the oldest record of a record ring without removing it (consumer side)
+ *
+ * @param[in]   ring        Pointer to the ring
+ * @param[out]  data        Pointer to the content of the record, valid until db_ring_pop is called
+ *
+ * @return the length of the record, 0 if the ring is empty
+ */
+size_t db_ring_peek(const db_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief   Remove the oldest record of a record ring (consumer side)
+ *
+ * @param[in]   ring        Pointer to the ring
+ */
+void db_ring_pop(db_ring_t *ring);
+
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file ring.c
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform implementation of the "ring" driver module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ring.h"
+
+//=========================== defines ==========================================
+
+#define DB_RING_RECORD_PADDING (0xFFFFFFFFUL)  ///< Header value marking the unused end of the storage
+
+//=========================== prototypes =======================================
+
+static inline uint32_t _db_ring_load(const volatile uint32_t *index);
+static inline void     _db_ring_store(volatile uint32_t *index, uint32_t value);
+static inline void     _db_ring_update_high_water(db_ring_t *ring, uint32_t head, uint32_t tail);
+
+//=========================== public ===========================================
+
+void db_ring_init(db_ring_t *ring, uint8_t *buffer, uint32_t size) {
+    assert(size >= DB_RING_RECORD_HEADER_SIZE && (size & (size - 1)) == 0);
+    ring->buffer     = buffer;
+    ring->size       = size;
+    ring->head       = 0;
+    ring->tail       = 0;
+    ring->dropped    = 0;
+    ring->high_water = 0;
+}
+
+uint32_t db_ring_used(const db_ring_t *ring) {
+    return _db_ring_load(&ring->head) - _db_ring_load(&ring->tail);
+}
+
+uint32_t db_ring_free(const db_ring_t *ring) {
+    return ring->size - db_ring_used(ring);
+}
+
+bool db_ring_is_empty(const db_ring_t *ring) {
+    return db_ring_used(ring) == 0;
+}
+
+bool db_ring_is_full(const db_ring_t *ring) {
+    return db_ring_used(ring) == ring->size;
+}
+
+size_t db_ring_write(db_ring_t *ring, const uint8_t *data, size_t length) {
+    uint32_t head    = ring->head;
+    uint32_t tail    = _db_ring_load(&ring->tail);
+    size_t   written = ring->size - (head - tail);
+    if (written > length) {
+        written = length;
+    }
+    ring->dropped += length - written;
+
+    // Copy in 2 parts if the end of the storage is reached
+    uint32_t index = head & (ring->size - 1);
+    size_t   first = ring->size - index;
+    if (first > written) {
+        first = written;
+    }
+    memcpy(&ring->buffer[index], data, first);
+    memcpy(ring->buffer, &data[first], written - first);
+
+    head += written;
+    _db_ring_update_high_water(ring, head, tail);
+    _db_ring_store(&ring->head, head);
+    return written;
+}
+
+size_t db_ring_read_span(const db_ring_t *ring, const uint8_t **data) {
+    uint32_t tail  = ring->tail;
+    uint32_t used  = _db_ring_load(&ring->head) - tail;
+    uint32_t index = tail & (ring->size - 1);
+    if (used > ring->size - index) {
+        used = ring->size - index;
+    }
+    *data = &ring->buffer[index];
+    return used;
+}
+
+void db_ring_consume(db_ring_t *ring, size_t length) {
+    _db_ring_store(&ring->tail, ring->tail + length);
+}
+
+bool db_ring_push(db_ring_t *ring, const uint8_t *data, size_t length) {
+    uint32_t needed = DB_RING_RECORD_SIZE(length);
+    if (length == 0 || needed > ring->size) {
+        ring->dropped++;
+        return false;
+    }
+
+    uint32_t head       = ring->head;
+    uint32_t tail       = _db_ring_load(&ring->tail);
+    uint32_t index      = head & (ring->size - 1);
+    uint32_t contiguous = ring->size - index;
+    // A record never wraps around, the end of the storage is skipped if it's too small
+    uint32_t padding = (contiguous < needed) ? contiguous : 0;
+    if ((head - tail) + padding + needed > ring->size) {
+        ring->dropped++;
+        return false;
+    }
+
+    if (padding) {
+        uint32_t header = DB_RING_RECORD_PADDING;
+        memcpy(&ring->buffer[index], &header, sizeof(header));
+        index = 0;
+    }
+    head += padding;
+
+    uint32_t header = length;
+    memcpy(&ring->buffer[index], &header, sizeof(header));
+    memcpy(&ring->buffer[index + DB_RING_RECORD_HEADER_SIZE], data, length);
+
+    head += needed;
+    _db_ring_update_high_water(ring, head, tail);
+    // Publish the record once it's completely written
+    _db_ring_store(&ring->head, head);
+    return true;
+}
+
+size_t db_ring_peek(const db_ring_t *ring, const uint8_t **data) {
+    uint32_t tail = ring->tail;
+    if (_db_ring_load(&ring->head) == tail) {
+        return 0;
+    }
+
+    uint32_t index = tail & (ring->size - 1);
+    uint32_t header;
+    memcpy(&header, &ring->buffer[index], sizeof(header));
+    if (header == DB_RING_RECORD_PADDING) {
+        // The record is at the beginning of the storage
+        index = 0;
+        memcpy(&header, ring->buffer, sizeof(header));
+    }
+
+    *data = &ring->buffer[index + DB_RING_RECORD_HEADER_SIZE];
+    return header;
+}
+
+void db_ring_pop(db_ring_t *ring) {
+    uint32_t tail = ring->tail;
+    if (_db_ring_load(&ring->head) == tail) {
+        return;
+    }
+
+    uint32_t index = tail & (ring->size - 1);
+    uint32_t header;
+    memcpy(&header, &ring->buffer[index], sizeof(header));
+    if (header == DB_RING_RECORD_PADDING) {
+        tail += ring->size - index;
+        memcpy(&header, ring->buffer, sizeof(header));
+    }
+
+    _db_ring_store(&ring->tail, tail + DB_RING_RECORD_SIZE(header));
+}
+
+//=========================== private ==========================================
+
+static inline uint32_t _db_ring_load(const volatile uint32_t *index) {
+    // Acquire: the data written before the index was published is visible
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void _db_ring_store(volatile uint32_t *index, uint32_t value) {
+    // Release: the data is written before the index is published
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+static inline void _db_ring_update_high_water(db_ring_t *ring, uint32_t head, uint32_t tail) {
+    if (head - tail > ring->high_water) {
+        ring->high_water = head - tail;
+    }
+}
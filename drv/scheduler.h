@@ -0,0 +1,109 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+/**
+ * @file scheduler.h
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform declaration "scheduler" driver module.
+ *
+ * Cooperative run-to-completion scheduler. Work is split in tasks, each task has a handler and a
+ * priority. Interrupt handlers post tasks and return, handlers are called later from thread
+ * context, one after the other, by db_scheduler_run.
+ *
+ * Posting a task is O(1) and can be done from any context. A task posted several times before
+ * it runs is called once per post, no event is lost. Ready tasks are called by priority, then in
+ * the order they were posted.
+ *
+ * The scheduler measures the run time and the latency (delay between the first pending post and
+ * the call) of each task, in microseconds.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+typedef enum {
+    DB_SCHEDULER_PRIORITY_HIGH,    ///< Time critical work (control loops, safety)
+    DB_SCHEDULER_PRIORITY_NORMAL,  ///< Regular work (sensors processing)
+    DB_SCHEDULER_PRIORITY_LOW,     ///< Background work (advertisements, replies)
+    DB_SCHEDULER_PRIORITY_COUNT,   ///< Number of priority levels
+} db_scheduler_priority_t;
+
+typedef void (*db_scheduler_handler_t)(void);  ///< Task handler prototype, called from thread context
+
+typedef struct db_scheduler_task db_scheduler_task_t;
+
+/// Task, the storage is provided by the user and must remain valid while the task is used
+struct db_scheduler_task {
+    db_scheduler_task_t    *next;            ///< Next ready task with the same priority
+    db_scheduler_handler_t  handler;         ///< Function called each time the task is posted
+    db_scheduler_priority_t priority;        ///< Priority of the task
+    volatile uint32_t       pending;         ///< Number of posts not processed yet
+    uint32_t                posted;          ///< Time of the oldest pending post, in microseconds
+    uint32_t                runs;            ///< Number of times the handler was called
+    uint32_t                overruns;        ///< Number of posts done while the task was already pending
+    uint64_t                run_time_total;  ///< Total time spent in the handler, in microseconds
+    uint32_t                run_time_max;    ///< Longest time spent in the handler, in microseconds
+    uint32_t                latency_max;     ///< Longest delay between a post and the call of the handler, in microseconds
+};
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief   Initialize the scheduler (also initializes the high frequency timer)
+ */
+void db_scheduler_init(void);
+
+/**
+ * @brief   Initialize a task
+ *
+ * @param[out]  task        Pointer to the task
+ * @param[in]   handler     Function called each time the task is posted
+ * @param[in]   priority    Priority of the task
+ */
+void db_scheduler_task_init(db_scheduler_task_t *task, db_scheduler_handler_t handler, db_scheduler_priority_t priority);
+
+/**
+ * @brief   Post a task, its handler is called once for each post
+ *
+ * Can be called from interrupt and thread contexts.
+ *
+ * @param[in]   task        Pointer to the task
+ */
+void db_scheduler_post(db_scheduler_task_t *task);
+
+/**
+ * @brief   Call the handler of the next ready task
+ *
+ * @return true if a handler was called, false if no task is ready
+ */
+bool db_scheduler_process(void);
+
+/**
+ * @brief   Call the ready tasks forever, the CPU sleeps when no task is ready
+ */
+void db_scheduler_run(void);
+
+/**
+ * @brief   Set a function called by db_scheduler_run each time no task is ready, before sleeping
+ *
+ * Useful for background work without deadline (e.g. draining logs).
+ *
+ * @param[in]   handler     Function called when idle, NULL to disable
+ */
+void db_scheduler_set_idle_handler(db_scheduler_handler_t handler);
+
+/**
+ * @brief   Reset the run time and latency statistics of a task
+ *
+ * @param[in]   task        Pointer to the task
+ */
+void db_scheduler_stats_reset(db_scheduler_task_t *task);
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file scheduler.c
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform implementation of the "scheduler" driver module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <nrf.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "scheduler.h"
+#include "timer.h"
+#include "timer_hf.h"
+
+//=========================== defines ==========================================
+
+typedef struct {
+    db_scheduler_task_t *head;  ///< Oldest ready task
+    db_scheduler_task_t *tail;  ///< Newest ready task
+} db_scheduler_list_t;
+
+typedef struct {
+    db_scheduler_list_t    ready[DB_SCHEDULER_PRIORITY_COUNT];  ///< Ready tasks, one FIFO per priority
+    uint32_t               ready_mask;                          ///< Bit n is set when the list of priority n is not empty
+    db_scheduler_handler_t idle_handler;                        ///< Called when no task is ready, can be NULL
+} db_scheduler_vars_t;
+
+//=========================== variables ========================================
+
+static db_scheduler_vars_t _scheduler_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static inline void _db_scheduler_append(db_scheduler_task_t *task);
+
+//=========================== public ===========================================
+
+void db_scheduler_init(void) {
+    // Posts are timestamped with the RTC (no side effect, safe from interrupts), run times with the high frequency timer
+    db_timer_init();
+    db_timer_hf_init();
+}
+
+void db_scheduler_task_init(db_scheduler_task_t *task, db_scheduler_handler_t handler, db_scheduler_priority_t priority) {
+    assert(handler);
+    assert(priority < DB_SCHEDULER_PRIORITY_COUNT);
+    task->next     = NULL;
+    task->handler  = handler;
+    task->priority = priority;
+    task->pending  = 0;
+    db_scheduler_stats_reset(task);
+}
+
+void db_scheduler_post(db_scheduler_task_t *task) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (task->pending++ == 0) {
+        task->posted = (uint32_t)db_timer_now_us();
+        _db_scheduler_append(task);
+    } else {
+        task->overruns++;
+    }
+    __set_PRIMASK(primask);
+
+    // Don't let the main loop go to sleep if it was about to
+    __SEV();
+}
+
+bool db_scheduler_process(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (_scheduler_vars.ready_mask == 0) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    // The lowest bit set is the highest priority with a ready task
+    db_scheduler_list_t *list = &_scheduler_vars.ready[__builtin_ctz(_scheduler_vars.ready_mask)];
+    db_scheduler_task_t *task = list->head;
+    list->head                = task->next;
+    if (list->head == NULL) {
+        list->tail = NULL;
+        _scheduler_vars.ready_mask &= ~(1UL << task->priority);
+    }
+    task->next = NULL;
+
+    uint32_t now     = (uint32_t)db_timer_now_us();
+    uint32_t latency = now - task->posted;
+    if (--task->pending > 0) {
+        // Posted again in the meantime, go back at the end of the list so other tasks of the same priority can run
+        task->posted = now;
+        _db_scheduler_append(task);
+    }
+    __set_PRIMASK(primask);
+
+    uint32_t start = db_timer_hf_now();
+    task->handler();
+    uint32_t run_time = db_timer_hf_now() - start;
+
+    task->runs++;
+    task->run_time_total += run_time;
+    if (run_time > task->run_time_max) {
+        task->run_time_max = run_time;
+    }
+    if (latency > task->latency_max) {
+        task->latency_max = latency;
+    }
+    return true;
+}
+
+void db_scheduler_run(void) {
+    while (1) {
+        if (!db_scheduler_process()) {
+            if (_scheduler_vars.idle_handler) {
+                _scheduler_vars.idle_handler();
+            }
+            // Posts call __SEV, a post done right before this instruction doesn't get lost
+            __WFE();
+        }
+    }
+}
+
+void db_scheduler_set_idle_handler(db_scheduler_handler_t handler) {
+    _scheduler_vars.idle_handler = handler;
+}
+
+void db_scheduler_stats_reset(db_scheduler_task_t *task) {
+    task->runs           = 0;
+    task->overruns       = 0;
+    task->run_time_total = 0;
+    task->run_time_max   = 0;
+    task->latency_max    = 0;
+}
+
+//=========================== private ==========================================
+
+static inline void _db_scheduler_append(db_scheduler_task_t *task) {
+    db_scheduler_list_t *list = &_scheduler_vars.ready[task->priority];
+    if (list->tail == NULL) {
+        list->head = task;
+    } else {
+        list->tail->next = task;
+    }
+    list->tail = task;
+    _scheduler_vars.ready_mask |= (1UL << task->priority);
+}
@@ -0,0 +1,83 @@
+#ifndef __WHEELS_H
+#define __WHEELS_H
+
+/**
+ * @file wheels.h
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform declaration "wheels" driver module.
+ *
+ * Closed loop speed control of the DotBot wheels. Each wheel has its own PID, updated from the
+ * timer interrupt each time the rpm driver measures a new speed (every DB_RPM_UPDATE_PERIOD_MS).
+ * The motor duty cycle is the sum of a feed-forward term, computed from the target speed, and of
+ * the PID correction. The PID output range is reduced to what the feed-forward leaves, so the
+ * integral term can't wind up while the motor is saturated. Target changes are ramped up to
+ * DB_WHEELS_ACCELERATION_MAX.
+ *
+ * The encoders don't give the direction of rotation, the measured speed is assumed to have the
+ * sign of the target.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdint.h>
+
+//=========================== defines ==========================================
+
+#ifndef DB_WHEELS_KP
+#define DB_WHEELS_KP (1.0f)  ///< Proportional gain, in % of duty cycle per cm/s
+#endif
+
+#ifndef DB_WHEELS_KI
+#define DB_WHEELS_KI (4.0f)  ///< Integral gain, in % of duty cycle per cm
+#endif
+
+#ifndef DB_WHEELS_FF_GAIN
+#define DB_WHEELS_FF_GAIN (0.6f)  ///< Feed-forward gain, in % of duty cycle per cm/s
+#endif
+
+#ifndef DB_WHEELS_FF_OFFSET
+#define DB_WHEELS_FF_OFFSET (15.0f)  ///< Feed-forward duty cycle needed to overcome the static friction, in %
+#endif
+
+#ifndef DB_WHEELS_ACCELERATION_MAX
+#define DB_WHEELS_ACCELERATION_MAX (100U)  ///< Max change of the target speed, in cm/s^2
+#endif
+
+//=========================== prototypes =======================================
+
+/**
+ * @brief   Initialize the speed control (also initializes the rpm driver), the motors must be initialized before
+ */
+void db_wheels_init(void);
+
+/**
+ * @brief   Set the target speed of the wheels and start the closed loop control
+ *
+ * @param[in] left          Target speed of the left wheel, in cm/s (negative values go backward)
+ * @param[in] right         Target speed of the right wheel, in cm/s (negative values go backward)
+ */
+void db_wheels_set_speed(int16_t left, int16_t right);
+
+/**
+ * @brief   Speed a duty cycle gives according to the feed-forward model
+ *
+ * Lets code written for open loop duty cycles use the closed loop control with the same behavior
+ * until it is tuned in cm/s.
+ *
+ * @param[in] duty_cycle    Duty cycle, in % (negative values go backward)
+ *
+ * @return the speed in cm/s, 0 if the duty cycle is too low to overcome the static friction
+ */
+int16_t db_wheels_speed_from_duty_cycle(int16_t duty_cycle);
+
+/**
+ * @brief   Stop the closed loop control and the motors immediately
+ *
+ * The motors can then be driven in open loop with db_motors_set_speed.
+ */
+void db_wheels_stop(void);
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file wheels.c
+ * @addtogroup DRV
+ *
+ * @brief  Cross-platform implementation of the "wheels" driver module.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <nrf.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "motors.h"
+#include "pid.h"
+#include "rpm.h"
+#include "wheels.h"
+
+//=========================== defines ==========================================
+
+#define WHEELS_DUTY_CYCLE_MAX (100.0f)                                                       ///< Max duty cycle accepted by the motors, in %
+#define WHEELS_SPEED_STEP     (DB_WHEELS_ACCELERATION_MAX * DB_RPM_UPDATE_PERIOD_MS / 1000)  ///< Max change of the setpoint at each update, in cm/s
+
+_Static_assert(WHEELS_SPEED_STEP > 0, "DB_WHEELS_ACCELERATION_MAX is too low for the rpm update rate");
+
+typedef struct {
+    pid_t   pid;       ///< Speed control loop, works on the absolute values of the speeds
+    int16_t target;    ///< Requested speed, in cm/s
+    int16_t setpoint;  ///< Current target of the control loop, moves toward the requested speed, in cm/s
+} wheels_side_t;
+
+typedef struct {
+    wheels_side_t left;     ///< Left wheel
+    wheels_side_t right;    ///< Right wheel
+    bool          enabled;  ///< Whether the closed loop control drives the motors
+} wheels_vars_t;
+
+//=========================== variables ========================================
+
+static wheels_vars_t _wheels_vars = { 0 };
+
+//=========================== prototypes =======================================
+
+static void    _wheels_reset(wheels_side_t *side);
+static int16_t _wheels_update_side(wheels_side_t *side, float speed);
+static void    _wheels_update(void);
+
+//=========================== public ===========================================
+
+void db_wheels_init(void) {
+    _wheels_reset(&_wheels_vars.left);
+    _wheels_reset(&_wheels_vars.right);
+    _wheels_vars.enabled = false;
+
+    db_rpm_init();
+    db_rpm_set_update_callback(&_wheels_update);
+}
+
+void db_wheels_set_speed(int16_t left, int16_t right) {
+    // the control loop runs from the timer interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _wheels_vars.left.target  = left;
+    _wheels_vars.right.target = right;
+    _wheels_vars.enabled      = true;
+    __set_PRIMASK(primask);
+}
+
+void db_wheels_stop(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _wheels_vars.enabled = false;
+    _wheels_reset(&_wheels_vars.left);
+    _wheels_reset(&_wheels_vars.right);
+    db_motors_set_speed(0, 0);
+    __set_PRIMASK(primask);
+}
+
+int16_t db_wheels_speed_from_duty_cycle(int16_t duty_cycle) {
+    // inverse of the feed-forward term computed in _wheels_update_side
+    float magnitude = fminf(fabsf((float)duty_cycle), WHEELS_DUTY_CYCLE_MAX) - DB_WHEELS_FF_OFFSET;
+    if (magnitude <= 0) {
+        return 0;
+    }
+    int16_t speed = (int16_t)lroundf(magnitude / DB_WHEELS_FF_GAIN);
+    return (duty_cycle > 0) ? speed : -speed;
+}
+
+//=========================== private ==========================================
+
+static void _wheels_reset(wheels_side_t *side) {
+    side->target   = 0;
+    side->setpoint = 0;
+    db_pid_init(&side->pid, 0, 0,
+                DB_WHEELS_KP, DB_WHEELS_KI, 0,
+                -WHEELS_DUTY_CYCLE_MAX, WHEELS_DUTY_CYCLE_MAX,
+                DB_RPM_UPDATE_PERIOD_MS, DB_PID_MODE_AUTO, DB_PID_DIRECTION_DIRECT);
+}
+
+static int16_t _wheels_update_side(wheels_side_t *side, float speed) {
+    // slew limiting, the setpoint goes through 0 when the direction changes
+    int16_t delta = side->target - side->setpoint;
+    if (delta > (int16_t)WHEELS_SPEED_STEP) {
+        delta = WHEELS_SPEED_STEP;
+    } else if (delta < -(int16_t)WHEELS_SPEED_STEP) {
+        delta = -(int16_t)WHEELS_SPEED_STEP;
+    }
+    side->setpoint += delta;
+
+    if (side->setpoint == 0) {
+        // the integral term restarts from 0 when the wheel starts again
+        int16_t target = side->target;
+        _wheels_reset(side);
+        side->target = target;
+        return 0;
+    }
+
+    float magnitude   = fabsf((float)side->setpoint);
+    float feedforward = fminf(DB_WHEELS_FF_OFFSET + DB_WHEELS_FF_GAIN * magnitude, WHEELS_DUTY_CYCLE_MAX);
+
+    // anti-windup: the output of the PID, and so its integral term, is clamped to the range left by the feed-forward
+    db_pid_set_output_limits(&side->pid, -feedforward, WHEELS_DUTY_CYCLE_MAX - feedforward);
+    side->pid.target = magnitude;
+    side->pid.input  = speed;
+    db_pid_update(&side->pid);
+
+    int16_t duty_cycle = (int16_t)lroundf(feedforward + side->pid.output);
+    return (side->setpoint > 0) ? duty_cycle : -duty_cycle;
+}
+
+static void _wheels_update(void) {
+    if (!_wheels_vars.enabled) {
+        return;
+    }
+
+    rpm_values_t values;
+    db_rpm_get_values(&values);
+    int16_t left  = _wheels_update_side(&_wheels_vars.left, values.left.speed);
+    int16_t right = _wheels_update_side(&_wheels_vars.right, values.right.speed);
+    db_motors_set_speed(left, right);
+}
@@ -65,9 +65,7 @@ int main(void) {
     db_radio_set_frequency(RADIO_FREQ);
 
     while (1) {
-        db_radio_rx_disable();
-        db_radio_tx((uint8_t *)packet_tx, sizeof(packet_tx) / sizeof(packet_tx[0]));
-        db_radio_rx_enable();
+        db_radio_send((uint8_t *)packet_tx, sizeof(packet_tx) / sizeof(packet_tx[0]));
         db_timer_hf_delay_ms(DELAY_MS);
     }
 
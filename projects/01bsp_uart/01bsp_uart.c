@@ -37,12 +37,15 @@ static uart_vars_t _uart_vars = { 0 };
 
 //=========================== callbacks ========================================
 
-static void uart_callback(uint8_t byte) {
-    _uart_vars.buffer[_uart_vars.pos] = byte;
-    _uart_vars.pos++;
-    if (byte == '\n' || _uart_vars.pos == DB_UART_MAX_BYTES - 1) {
-        db_uart_write(_uart_vars.buffer, _uart_vars.pos - 1);
-        _uart_vars.pos = 0;
+static void uart_callback(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte                      = data[i];
+        _uart_vars.buffer[_uart_vars.pos] = byte;
+        _uart_vars.pos++;
+        if (byte == '\n' || _uart_vars.pos == DB_UART_MAX_BYTES - 1) {
+            db_uart_write(_uart_vars.buffer, _uart_vars.pos - 1);
+            _uart_vars.pos = 0;
+        }
     }
 }
 
@@ -0,0 +1,92 @@
+/**
+ * @file 01drv_ahrs.c
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ * @brief This is a short example of how to use the AHRS driver with the ISM330 IMU available on the DotBot
+ *
+ * The DotBot has no magnetometer, the heading is only given by the integration of the gyroscope
+ * (it drifts slowly), roll and pitch are corrected by the accelerometer.
+ *
+ * @copyright Inria, 2023
+ *
+ */
+#include <nrf.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ahrs.h"
+#include "board.h"
+#include "ism330.h"
+#include "timer_hf.h"
+
+//=========================== defines ==========================================
+
+#define AHRS_UPDATE_PERIOD_US (10000U)  ///< 100 Hz
+#define AHRS_PRINT_PERIOD     (100U)    ///< print the orientation once per second
+
+typedef struct {
+    ahrs_t        ahrs;         ///< AHRS filter
+    volatile bool update;       ///< Whether an update is due
+    uint32_t      update_count;  ///< Number of updates
+} drv_ahrs_vars_t;
+
+//=========================== variables ========================================
+
+static drv_ahrs_vars_t _drv_ahrs_vars = { 0 };
+
+///! IMU SDA pin
+static const gpio_t _ism330_sda_gpio = {
+    .port = 0,
+    .pin  = 10,
+};
+
+///! IMU SCL pin
+static const gpio_t _ism330_scl_gpio = {
+    .port = 0,
+    .pin  = 9,
+};
+
+//=========================== callbacks ========================================
+
+static void _update_callback(void) {
+    _drv_ahrs_vars.update = true;
+}
+
+//=========================== main =============================================
+
+int main(void) {
+    ism330_acc_data_t  acc_data;
+    ism330_gyro_data_t gyro_data;
+    float              roll, pitch, heading;
+
+    db_board_init();
+    db_ism330_init(&_ism330_sda_gpio, &_ism330_scl_gpio);
+    db_ahrs_init(&_drv_ahrs_vars.ahrs, DB_AHRS_KP_DEFAULT, DB_AHRS_KI_DEFAULT);
+    db_timer_hf_init();
+    db_timer_hf_set_periodic_us(0, AHRS_UPDATE_PERIOD_US, &_update_callback);
+
+    while (1) {
+        __WFE();
+
+        if (!_drv_ahrs_vars.update) {
+            continue;
+        }
+        _drv_ahrs_vars.update = false;
+
+        db_ism330_accel_read(&acc_data);
+        db_ism330_gyro_read(&gyro_data);
+
+        // db_ism330_accel_read returns the opposite of the specific force
+        const ahrs_vector_t accel = { .x = -acc_data.x, .y = -acc_data.y, .z = -acc_data.z };
+        const ahrs_vector_t gyro  = { .x = gyro_data.x, .y = gyro_data.y, .z = gyro_data.z };
+        db_ahrs_update(&_drv_ahrs_vars.ahrs, &gyro, &accel, NULL, AHRS_UPDATE_PERIOD_US / 1e6f);
+
+        if (++_drv_ahrs_vars.update_count % AHRS_PRINT_PERIOD == 0) {
+            db_ahrs_euler(&_drv_ahrs_vars.ahrs, &roll, &pitch, &heading);
+            printf("roll: %f, pitch: %f, heading: %f\n", roll * 180 / M_PI, pitch * 180 / M_PI, heading * 180 / M_PI);
+        }
+    }
+
+    // one last instruction, doesn't do anything, it's just to have a place to put a breakpoint.
+    __NOP();
+}
@@ -47,12 +47,13 @@ int main(void) {
         ;
     }
 #else
-    float heading;
+    lis2mdl_compass_data_t data;
+    float                  heading;
 
     while (1) {
         // processor idle until an interrupt occurs and is handled
         if (lis2mdl_data_ready()) {
-            lis2mdl_read_heading();
+            lis2mdl_read_magnetometer(&data);
             heading = lis2mdl_last_heading() * 180 / CONST_PI;
             printf("heading: %f\n", heading);
         }
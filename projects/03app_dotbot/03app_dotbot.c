@@ -13,35 +13,45 @@
 #include <nrf.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include <stdio.h>
 // Include BSP headers
 #include "board.h"
 #include "device.h"
+#include "fixmath.h"
 #include "lh2.h"
 #include "protocol.h"
 #include "motors.h"
+#include "profile.h"
 #include "radio.h"
 #include "rgbled.h"
+#include "scheduler.h"
 #include "timer.h"
+#include "vtimer.h"
+#include "wheels.h"
 
 //=========================== defines ==========================================
 
 #define DB_LH2_UPDATE_DELAY_MS    (100U)   ///< 100ms delay between each LH2 data refresh
 #define DB_ADVERTIZEMENT_DELAY_MS (500U)   ///< 500ms delay between each advertizement packet sending
 #define DB_TIMEOUT_CHECK_DELAY_MS (200U)   ///< 200ms delay between each timeout delay check
-#define TIMEOUT_CHECK_DELAY_TICKS (17000)  ///< ~500 ms delay between packet received timeout checks
+#define TIMEOUT_CHECK_DELAY_TICKS (17000)  ///< ~519 ms (32768 Hz RTC ticks) delay between packet received timeout checks
 #define DB_LH2_FULL_COMPUTATION   (false)  ///< Wether the full LH2 computation is perform on board
 #define DB_LH2_COUNTER_MASK       (0x07)   ///< Maximum number of lh2 iterations without value received
 #define DB_BUFFER_MAX_BYTES       (255U)   ///< Max bytes in UART receive buffer
-#define DB_DIRECTION_THRESHOLD    (0.01)   ///< Threshold to update the direction
+#define DB_DIRECTION_THRESHOLD    (10000)  ///< Threshold to update the direction (0.01, in micro-units)
 #define DB_DIRECTION_INVALID      (-1000)  ///< Invalid angle e.g out of [0, 360] range
-#define DB_MAX_SPEED              (60)     ///< Max speed in autonomous control mode
-#define DB_REDUCE_SPEED_FACTOR    (0.9)    ///< Reduction factor applied to speed when close to target or error angle is too large
+#define DB_MAX_SPEED              (60)     ///< Max speed in autonomous control mode, in % of duty cycle (converted with the wheels feed-forward model)
+#define DB_REDUCE_SPEED_FACTOR    (90)     ///< Reduction factor (in percent) applied to speed when close to target or error angle is too large
 #define DB_ANGULAR_SPEED_FACTOR   (30)     ///< Constant applied to the normalized angle to target error
 
+typedef enum {
+    DB_PROFILE_ID_LH2_PROCESS  = 1,  ///< LH2 raw data processing
+    DB_PROFILE_ID_CONTROL_LOOP = 2,  ///< Control loop update
+    DB_PROFILE_ID_LH2_LATENCY  = 3,  ///< Delay between the LH2 timer interrupt and the LH2 data processing
+} dotbot_profile_id_t;
+
 typedef struct {
-    uint32_t                 ts_last_packet_received;            ///< Last timestamp in microseconds a control packet was received
+    volatile uint64_t        ts_last_packet_received;            ///< Last timestamp in ticks a control packet was received (written from the radio interrupt)
     db_lh2_t                 lh2;                                ///< LH2 device descriptor
     uint8_t                  radio_buffer[DB_BUFFER_MAX_BYTES];  ///< Internal buffer that contains the command to send (from buttons)
     protocol_lh2_location_t  last_location;                      ///< Last computed LH2 location received
@@ -50,11 +60,21 @@ typedef struct {
     protocol_lh2_waypoints_t waypoints;                          ///< List of waypoints
     uint32_t                 waypoints_threshold;                ///< Distance to target waypoint threshold
     uint8_t                  next_waypoint_idx;                  ///< Index of next waypoint to reach
-    bool                     update_control_loop;                ///< Whether the control loop need an update
     bool                     advertize;                          ///< Whether an advertize packet should be sent
-    bool                     update_lh2;                         ///< Whether LH2 data must be processed
     uint8_t                  lh2_update_counter;                 ///< Counter used to track when lh2 data were received and to determine if an advertizement packet is needed
     uint64_t                 device_id;                          ///< Device ID of the DotBot
+    protocol_echo_t          echo;                               ///< Last echo request received
+    uint64_t                 echo_dst;                           ///< Address of the sender of the last echo request
+    vtimer_t                 timeout_timer;                      ///< Timer used to check the control packets timeout
+    vtimer_t                 advertise_timer;                    ///< Timer used to send advertizement packets
+    vtimer_t                 lh2_timer;                          ///< Timer used to refresh the LH2 data
+    db_scheduler_task_t      control_task;                       ///< Runs the control loop when a new location is received
+    db_scheduler_task_t      timeout_task;                       ///< Stops the motors when no control packet is received
+    db_scheduler_task_t      lh2_task;                           ///< Processes the LH2 data
+    db_scheduler_task_t      advertise_task;                     ///< Allows sending an advertizement packet
+    db_scheduler_task_t      echo_task;                          ///< Sends the echo reply
+    db_scheduler_task_t      profile_task;                       ///< Sends the profiling results
+    bool                     profile_reset;                      ///< Whether the profiling results are reset once sent
 } dotbot_vars_t;
 
 //=========================== variables ========================================
@@ -73,20 +93,43 @@ static const gpio_t _lh2_d_gpio = {
 
 static dotbot_vars_t _dotbot_vars;
 
+DB_PROFILE_PROBE(_lh2_process_probe, DB_PROFILE_ID_LH2_PROCESS);
+DB_PROFILE_PROBE(_control_loop_probe, DB_PROFILE_ID_CONTROL_LOOP);
+DB_PROFILE_PROBE(_lh2_latency_probe, DB_PROFILE_ID_LH2_LATENCY);
+
 //=========================== prototypes =======================================
 
 static void _timeout_check(void);
 static void _advertise(void);
 static void _compute_angle(const protocol_lh2_location_t *next, const protocol_lh2_location_t *origin, int16_t *angle);
 static void _update_control_loop(void);
+static void _control_loop(void);
 static void _update_lh2(void);
+static void _send_echo_reply(void);
+static void _send_profile(void);
+static void _post_timeout_check(void);
+static void _post_advertise(void);
+static void _post_update_lh2(void);
 
 //=========================== callbacks ========================================
 
+static void _post_timeout_check(void) {
+    db_scheduler_post(&_dotbot_vars.timeout_task);
+}
+
+static void _post_advertise(void) {
+    db_scheduler_post(&_dotbot_vars.advertise_task);
+}
+
+static void _post_update_lh2(void) {
+    DB_PROFILE_MARK(_lh2_latency_probe);
+    db_scheduler_post(&_dotbot_vars.lh2_task);
+}
+
 static void radio_callback(uint8_t *pkt, uint8_t len) {
     (void)len;
 
-    _dotbot_vars.ts_last_packet_received = db_timer_ticks();
+    _dotbot_vars.ts_last_packet_received = db_timer_ticks64();
     do {
         uint8_t           *ptk_ptr = pkt;
         protocol_header_t *header  = (protocol_header_t *)ptk_ptr;
@@ -113,6 +156,8 @@ static void radio_callback(uint8_t *pkt, uint8_t len) {
                 protocol_move_raw_command_t *command = (protocol_move_raw_command_t *)cmd_ptr;
                 int16_t                      left    = (int16_t)(100 * ((float)command->left_y / INT8_MAX));
                 int16_t                      right   = (int16_t)(100 * ((float)command->right_y / INT8_MAX));
+                // joystick commands stay open loop, the closed loop control would override them
+                db_wheels_stop();
                 db_motors_set_speed(left, right);
             } break;
             case DB_PROTOCOL_CMD_RGB_LED:
@@ -131,14 +176,16 @@ static void radio_callback(uint8_t *pkt, uint8_t len) {
                     _dotbot_vars.last_location.z = location->z;
                     _dotbot_vars.direction       = angle;
                 }
-                _dotbot_vars.update_control_loop = (_dotbot_vars.control_mode == ControlAuto);
+                if (_dotbot_vars.control_mode == ControlAuto) {
+                    db_scheduler_post(&_dotbot_vars.control_task);
+                }
             } break;
             case DB_PROTOCOL_CONTROL_MODE:
-                db_motors_set_speed(0, 0);
+                db_wheels_stop();
                 break;
             case DB_PROTOCOL_LH2_WAYPOINTS:
             {
-                db_motors_set_speed(0, 0);
+                db_wheels_stop();
                 _dotbot_vars.control_mode        = ControlManual;
                 _dotbot_vars.waypoints.length    = (uint8_t)*cmd_ptr++;
                 _dotbot_vars.waypoints_threshold = (uint32_t)((uint8_t)*cmd_ptr++ * 1000);
@@ -148,6 +195,18 @@ static void radio_callback(uint8_t *pkt, uint8_t len) {
                     _dotbot_vars.control_mode = ControlAuto;
                 }
             } break;
+            case DB_PROTOCOL_ECHO_REQUEST:
+                // The reply is sent from thread context
+                memcpy(&_dotbot_vars.echo, cmd_ptr, sizeof(protocol_echo_t));
+                _dotbot_vars.echo_dst = header->src;
+                db_scheduler_post(&_dotbot_vars.echo_task);
+                break;
+            case DB_PROTOCOL_PROFILE_REQ:
+            {
+                const protocol_profile_request_t *request = (const protocol_profile_request_t *)cmd_ptr;
+                _dotbot_vars.profile_reset                = request->reset;
+                db_scheduler_post(&_dotbot_vars.profile_task);
+            } break;
             default:
                 break;
         }
@@ -160,79 +219,41 @@ static void radio_callback(uint8_t *pkt, uint8_t len) {
  *  @brief The program starts executing here.
  */
 int main(void) {
+    DB_PROFILE_INIT();
     db_board_init();
     db_rgbled_init();
     db_motors_init();
+    db_wheels_init();
     db_radio_init(&radio_callback, DB_RADIO_BLE_1MBit);
     db_radio_set_frequency(8);  // Set the RX frequency to 2408 MHz.
     db_radio_rx_enable();       // Start receiving packets.
 
     // Set an invalid heading since the value is unknown on startup.
     // Control loop is stopped and advertize packets are sent
-    _dotbot_vars.direction           = DB_DIRECTION_INVALID;
-    _dotbot_vars.update_control_loop = false;
-    _dotbot_vars.advertize           = false;
-    _dotbot_vars.update_lh2          = false;
-    _dotbot_vars.lh2_update_counter  = 0;
+    _dotbot_vars.direction          = DB_DIRECTION_INVALID;
+    _dotbot_vars.advertize          = false;
+    _dotbot_vars.lh2_update_counter = 0;
 
     // Retrieve the device id once at startup
     _dotbot_vars.device_id = db_device_id();
 
-    db_timer_init();
-    db_timer_set_periodic_ms(0, DB_TIMEOUT_CHECK_DELAY_MS, &_timeout_check);
-    db_timer_set_periodic_ms(1, DB_ADVERTIZEMENT_DELAY_MS, &_advertise);
-    db_timer_set_periodic_ms(2, DB_LH2_UPDATE_DELAY_MS, &_update_lh2);
+    // All the work is done from thread context, interrupts only post tasks
+    db_scheduler_init();
+    db_scheduler_task_init(&_dotbot_vars.control_task, &_control_loop, DB_SCHEDULER_PRIORITY_HIGH);
+    db_scheduler_task_init(&_dotbot_vars.timeout_task, &_timeout_check, DB_SCHEDULER_PRIORITY_HIGH);
+    db_scheduler_task_init(&_dotbot_vars.lh2_task, &_update_lh2, DB_SCHEDULER_PRIORITY_NORMAL);
+    db_scheduler_task_init(&_dotbot_vars.advertise_task, &_advertise, DB_SCHEDULER_PRIORITY_LOW);
+    db_scheduler_task_init(&_dotbot_vars.echo_task, &_send_echo_reply, DB_SCHEDULER_PRIORITY_LOW);
+    db_scheduler_task_init(&_dotbot_vars.profile_task, &_send_profile, DB_SCHEDULER_PRIORITY_LOW);
+
+    db_vtimer_init();
+    db_vtimer_set_periodic_ms(&_dotbot_vars.timeout_timer, DB_TIMEOUT_CHECK_DELAY_MS, &_post_timeout_check);
+    db_vtimer_set_periodic_ms(&_dotbot_vars.advertise_timer, DB_ADVERTIZEMENT_DELAY_MS, &_post_advertise);
+    db_vtimer_set_periodic_ms(&_dotbot_vars.lh2_timer, DB_LH2_UPDATE_DELAY_MS, &_post_update_lh2);
     db_lh2_init(&_dotbot_vars.lh2, &_lh2_d_gpio, &_lh2_e_gpio);
     db_lh2_start(&_dotbot_vars.lh2);
 
-    while (1) {
-        __WFE();
-
-        bool need_advertize = false;
-        if (_dotbot_vars.update_lh2) {
-            db_lh2_process_raw_data(&_dotbot_vars.lh2);
-            if (_dotbot_vars.lh2.state == DB_LH2_RAW_DATA_READY) {
-                _dotbot_vars.lh2_update_counter = 0;
-                db_lh2_stop(&_dotbot_vars.lh2);
-                db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_DOTBOT_DATA);
-                memcpy(_dotbot_vars.radio_buffer + sizeof(protocol_header_t), &_dotbot_vars.direction, sizeof(int16_t));
-                memcpy(_dotbot_vars.radio_buffer + sizeof(protocol_header_t) + sizeof(int16_t), _dotbot_vars.lh2.raw_data, sizeof(db_lh2_raw_data_t) * LH2_LOCATIONS_COUNT);
-                size_t length = sizeof(protocol_header_t) + sizeof(int16_t) + sizeof(db_lh2_raw_data_t) * LH2_LOCATIONS_COUNT;
-                db_radio_rx_disable();
-                db_radio_tx(_dotbot_vars.radio_buffer, length);
-                db_radio_rx_enable();
-                if (DB_LH2_FULL_COMPUTATION) {
-                    // the location function has to be running all the time
-                    db_lh2_process_location(&_dotbot_vars.lh2);
-
-                    // Reset the LH2 driver if a packet is ready. At this point, locations
-                    // can be read from lh2.results array
-                    if (_dotbot_vars.lh2.state == DB_LH2_LOCATION_READY) {
-                        __NOP();  // Add this no-op to allow setting a breakpoint here
-                    }
-                }
-                db_lh2_start(&_dotbot_vars.lh2);
-            } else {
-                _dotbot_vars.lh2_update_counter = (_dotbot_vars.lh2_update_counter + 1) & DB_LH2_COUNTER_MASK;
-                need_advertize                  = (_dotbot_vars.lh2_update_counter == DB_LH2_COUNTER_MASK);
-            }
-            _dotbot_vars.update_lh2 = false;
-        }
-
-        if (_dotbot_vars.update_control_loop) {
-            _update_control_loop();
-            _dotbot_vars.update_control_loop = false;
-        }
-
-        if (_dotbot_vars.advertize && need_advertize) {
-            db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_ADVERTISEMENT);
-            size_t length = sizeof(protocol_header_t);
-            db_radio_rx_disable();
-            db_radio_tx(_dotbot_vars.radio_buffer, length);
-            db_radio_rx_enable();
-            _dotbot_vars.advertize = false;
-        }
-    }
+    db_scheduler_run();
 
     // one last instruction, doesn't do anything, it's just to have a place to put a breakpoint.
     __NOP();
@@ -240,27 +261,35 @@ int main(void) {
 
 //=========================== private functions ================================
 
+static void _control_loop(void) {
+    DB_PROFILE_BEGIN(_control_loop_probe);
+    _update_control_loop();
+    DB_PROFILE_END(_control_loop_probe);
+}
+
 static void _update_control_loop(void) {
     if (_dotbot_vars.next_waypoint_idx >= _dotbot_vars.waypoints.length) {
-        db_motors_set_speed(0, 0);
+        db_wheels_stop();
         return;
     }
-    float dx               = ((float)_dotbot_vars.waypoints.points[_dotbot_vars.next_waypoint_idx].x - (float)_dotbot_vars.last_location.x) / 1e6;
-    float dy               = ((float)_dotbot_vars.waypoints.points[_dotbot_vars.next_waypoint_idx].y - (float)_dotbot_vars.last_location.y) / 1e6;
-    float distanceToTarget = sqrtf(powf(dx, 2) + powf(dy, 2));
+    // coordinates are in micro-units, the distance is computed without converting them
+    int32_t  dx               = (int32_t)(_dotbot_vars.waypoints.points[_dotbot_vars.next_waypoint_idx].x - _dotbot_vars.last_location.x);
+    int32_t  dy               = (int32_t)(_dotbot_vars.waypoints.points[_dotbot_vars.next_waypoint_idx].y - _dotbot_vars.last_location.y);
+    uint32_t distanceToTarget = db_fixmath_distance(dx, dy);
 
-    float speedReductionFactor = 1.0;  // No reduction by default
+    int16_t speedReductionFactor = 100;  // No reduction by default
 
-    if ((uint32_t)(distanceToTarget * 1e6) < _dotbot_vars.waypoints_threshold * 2) {
+    if (distanceToTarget < _dotbot_vars.waypoints_threshold * 2) {
         speedReductionFactor = DB_REDUCE_SPEED_FACTOR;
     }
 
-    if ((uint32_t)(distanceToTarget * 1e6) < _dotbot_vars.waypoints_threshold) {
+    if (distanceToTarget < _dotbot_vars.waypoints_threshold) {
         // Target waypoint is reached
         _dotbot_vars.next_waypoint_idx++;
     } else if (_dotbot_vars.direction == DB_DIRECTION_INVALID) {
         // Unknown direction, just move forward a bit
-        db_motors_set_speed((int16_t)DB_MAX_SPEED * speedReductionFactor, (int16_t)DB_MAX_SPEED * speedReductionFactor);
+        int16_t speed = db_wheels_speed_from_duty_cycle(DB_MAX_SPEED * speedReductionFactor / 100);
+        db_wheels_set_speed(speed, speed);
     } else {
         // compute angle to target waypoint
         int16_t angleToTarget = 0;
@@ -274,39 +303,44 @@ static void _update_control_loop(void) {
         if (errorAngle > 20 || errorAngle < -20) {
             speedReductionFactor = DB_REDUCE_SPEED_FACTOR;
         }
-        int16_t angularSpeed = (int16_t)(((float)errorAngle / 180) * 30);
-        int16_t left         = (int16_t)(((DB_MAX_SPEED * speedReductionFactor) - angularSpeed));
-        int16_t right        = (int16_t)(((DB_MAX_SPEED * speedReductionFactor) + angularSpeed));
+        int16_t angularSpeed = errorAngle * DB_ANGULAR_SPEED_FACTOR / 180;
+        int16_t left         = DB_MAX_SPEED * speedReductionFactor / 100 - angularSpeed;
+        int16_t right        = DB_MAX_SPEED * speedReductionFactor / 100 + angularSpeed;
         if (left > DB_MAX_SPEED) {
             left = DB_MAX_SPEED;
         }
         if (right > DB_MAX_SPEED) {
             right = DB_MAX_SPEED;
         }
-        db_motors_set_speed(left, right);
+        db_wheels_set_speed(db_wheels_speed_from_duty_cycle(left), db_wheels_speed_from_duty_cycle(right));
     }
 }
 
 static void _compute_angle(const protocol_lh2_location_t *next, const protocol_lh2_location_t *origin, int16_t *angle) {
-    float dx       = ((float)next->x - (float)origin->x) / 1e6;
-    float dy       = ((float)next->y - (float)origin->y) / 1e6;
-    float distance = sqrtf(powf(dx, 2) + powf(dy, 2));
+    int32_t dx = (int32_t)(next->x - origin->x);
+    int32_t dy = (int32_t)(next->y - origin->y);
 
-    if (distance < DB_DIRECTION_THRESHOLD) {
+    if (db_fixmath_distance(dx, dy) < DB_DIRECTION_THRESHOLD) {
         return;
     }
 
-    int8_t sideFactor = (dx > 0) ? -1 : 1;
-    *angle            = (int16_t)(acosf(dy / distance) * 180 / M_PI) * sideFactor;
+    // angle between the y axis and the direction, counterclockwise
+    *angle = (int16_t)(db_fixmath_atan2_cdeg(-dx, dy) / 100);
     if (*angle < 0) {
         *angle = 360 + *angle;
     }
 }
 
 static void _timeout_check(void) {
-    uint32_t ticks = db_timer_ticks();
-    if (ticks > _dotbot_vars.ts_last_packet_received + TIMEOUT_CHECK_DELAY_TICKS) {
-        db_motors_set_speed(0, 0);
+    // the 64 bits timestamp is written from the radio interrupt, read it at once
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t last_packet = _dotbot_vars.ts_last_packet_received;
+    __set_PRIMASK(primask);
+
+    uint64_t ticks = db_timer_ticks64();
+    if (ticks > last_packet + TIMEOUT_CHECK_DELAY_TICKS) {
+        db_wheels_stop();
     }
 }
 
@@ -315,5 +349,57 @@ static void _advertise(void) {
 }
 
 static void _update_lh2(void) {
-    _dotbot_vars.update_lh2 = true;
+    DB_PROFILE_LATENCY(_lh2_latency_probe);
+    DB_PROFILE_BEGIN(_lh2_process_probe);
+    db_lh2_process_raw_data(&_dotbot_vars.lh2);
+    DB_PROFILE_END(_lh2_process_probe);
+    if (_dotbot_vars.lh2.state != DB_LH2_RAW_DATA_READY) {
+        _dotbot_vars.lh2_update_counter = (_dotbot_vars.lh2_update_counter + 1) & DB_LH2_COUNTER_MASK;
+        if (_dotbot_vars.advertize && _dotbot_vars.lh2_update_counter == DB_LH2_COUNTER_MASK) {
+            db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_ADVERTISEMENT);
+            size_t length = sizeof(protocol_header_t);
+            db_radio_send(_dotbot_vars.radio_buffer, length);
+            _dotbot_vars.advertize = false;
+        }
+        return;
+    }
+
+    _dotbot_vars.lh2_update_counter = 0;
+    db_lh2_stop(&_dotbot_vars.lh2);
+    db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_DOTBOT_DATA);
+    memcpy(_dotbot_vars.radio_buffer + sizeof(protocol_header_t), &_dotbot_vars.direction, sizeof(int16_t));
+    memcpy(_dotbot_vars.radio_buffer + sizeof(protocol_header_t) + sizeof(int16_t), _dotbot_vars.lh2.raw_data, sizeof(db_lh2_raw_data_t) * LH2_LOCATIONS_COUNT);
+    size_t length = sizeof(protocol_header_t) + sizeof(int16_t) + sizeof(db_lh2_raw_data_t) * LH2_LOCATIONS_COUNT;
+    db_radio_send(_dotbot_vars.radio_buffer, length);
+    if (DB_LH2_FULL_COMPUTATION) {
+        // the location function has to be running all the time
+        db_lh2_process_location(&_dotbot_vars.lh2);
+
+        // Reset the LH2 driver if a packet is ready. At this point, locations
+        // can be read from lh2.results array
+        if (_dotbot_vars.lh2.state == DB_LH2_LOCATION_READY) {
+            __NOP();  // Add this no-op to allow setting a breakpoint here
+        }
+    }
+    db_lh2_start(&_dotbot_vars.lh2);
+}
+
+static void _send_echo_reply(void) {
+    db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, _dotbot_vars.echo_dst, DotBot, DB_PROTOCOL_ECHO_REPLY);
+    memcpy(_dotbot_vars.radio_buffer + sizeof(protocol_header_t), &_dotbot_vars.echo, sizeof(protocol_echo_t));
+    size_t length = sizeof(protocol_header_t) + sizeof(protocol_echo_t);
+    db_radio_send(_dotbot_vars.radio_buffer, length);
+}
+
+static void _send_profile(void) {
+    // The results may not fit in a single packet
+    uint8_t index = 0;
+    size_t  length;
+    while ((length = db_profile_report(_dotbot_vars.radio_buffer + sizeof(protocol_header_t), DB_BUFFER_MAX_BYTES - sizeof(protocol_header_t), &index)) != 0) {
+        db_protocol_header_to_buffer(_dotbot_vars.radio_buffer, DB_GATEWAY_ADDRESS, DotBot, DB_PROTOCOL_PROFILE_DATA);
+        db_radio_send(_dotbot_vars.radio_buffer, sizeof(protocol_header_t) + length);
+    }
+    if (_dotbot_vars.profile_reset) {
+        db_profile_reset();
+    }
 }
@@ -10,48 +10,76 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 // Include BSP headers
 #include "board.h"
+#include "downlink.h"
 #include "gpio.h"
 #include "hdlc.h"
+#include "profile.h"
 #include "protocol.h"
 #include "radio.h"
+#include "ring.h"
+#include "robots.h"
+#include "timer.h"
+#include "timer_hf.h"
 #include "uart.h"
 
 //=========================== defines ==========================================
 
-#define DB_BUFFER_MAX_BYTES (255U)                           ///< Max bytes in UART receive buffer
-#define DB_UART_BAUDRATE    (1000000UL)                      ///< UART baudrate used by the gateway
-#define DB_RADIO_QUEUE_SIZE (8U)                             ///< Size of the radio queue (must by a power of 2)
-#define DB_UART_QUEUE_SIZE  ((DB_BUFFER_MAX_BYTES + 1) * 2)  ///< Size of the UART queue size (must by a power of 2)
+#ifndef DB_GATEWAY_COALESCING
+#define DB_GATEWAY_COALESCING (0)  ///< Set to 1 to send the host periodic snapshots of the robots that changed instead of every packet
+#endif
 
-typedef struct {
-    uint8_t length;                       ///< Length of the radio packet
-    uint8_t buffer[DB_BUFFER_MAX_BYTES];  ///< Buffer containing the radio packet
-} gateway_radio_packet_t;
+#define DB_BUFFER_MAX_BYTES       (255U)                           ///< Max bytes in UART receive buffer
+#define DB_UART_BAUDRATE          (1000000UL)                      ///< UART baudrate used by the gateway
+#define DB_RADIO_QUEUE_SIZE       (2048U)                          ///< Size in bytes of the radio packets queue (must be a power of 2)
+#define DB_UART_QUEUE_SIZE        (512U)                           ///< Size in bytes of the UART queue (must be a power of 2)
+#define DB_BUTTONS_TIMER_CHANNEL  (0)                              ///< Timer channel used to repeat the move command while buttons are pressed
+#define DB_BUTTONS_REPEAT_MS      (100U)                           ///< Delay between 2 move commands while buttons are pressed
+#define DB_BUTTONS_MOVE_SPEED     (100)                            ///< Speed sent in move commands when buttons are pressed
+#define DB_SNAPSHOT_TIMER_CHANNEL (1)                              ///< Timer channel used to send the robots snapshots
+#define DB_SNAPSHOT_PERIOD_MS     (100U)                           ///< Delay between 2 robots snapshots
+#define DB_SNAPSHOT_MAX_BYTES     (480U)                           ///< Max size of a snapshot, its worst case HDLC frame must fit in the UART TX ring
+#define DB_HDLC_TX_MAX_BYTES      (DB_SNAPSHOT_MAX_BYTES * 2 + 6)  ///< Worst case HDLC frame: all bytes escaped plus 2 flags and 2 escaped FCS bytes
 
-typedef struct {
-    uint8_t                current;                       ///< Current position in the queue
-    uint8_t                last;                          ///< Position of the last item added in the queue
-    gateway_radio_packet_t packets[DB_RADIO_QUEUE_SIZE];  ///< Buffer containing the received bytes
-} gateway_radio_packet_queue_t;
+typedef enum {
+    DB_GATEWAY_EVENT_RADIO_RX = (1 << 0),  ///< A radio packet was received
+    DB_GATEWAY_EVENT_UART_RX  = (1 << 1),  ///< Bytes were received on UART
+    DB_GATEWAY_EVENT_BUTTONS  = (1 << 2),  ///< Buttons state changed or the move command must be repeated
+    DB_GATEWAY_EVENT_SNAPSHOT = (1 << 3),  ///< The robots snapshot must be sent to the host
+} gateway_event_t;
 
-typedef struct {
-    uint16_t current;                     ///< Current position in the queue
-    uint16_t last;                        ///< Position of the last item added in the queue
-    uint8_t  buffer[DB_UART_QUEUE_SIZE];  ///< Buffer containing the received bytes
-} gateway_uart_queue_t;
+typedef enum {
+    DB_PROFILE_ID_HDLC_ENCODE   = 1,  ///< HDLC encoding of a frame sent to the host
+    DB_PROFILE_ID_RADIO_FORWARD = 2,  ///< Delay between the reception of a radio packet and its forwarding to the host
+} gateway_profile_id_t;
+
+DB_RING_CHECK_SIZE(DB_RADIO_QUEUE_SIZE);
+DB_RING_CHECK_SIZE(DB_UART_QUEUE_SIZE);
+
+typedef struct __attribute__((packed)) {
+    uint64_t                    ticks;                        ///< Timer ticks when the packet was received
+    protocol_gateway_envelope_t envelope;                     ///< Reception time and RSSI, sent to the host right before the packet
+    uint8_t                     packet[DB_BUFFER_MAX_BYTES];  ///< Received packet
+} gateway_radio_rx_t;
 
 typedef struct {
-    db_hdlc_state_t              hdlc_state;                               ///< Current state of the HDLC decoding engine
-    uint8_t                      hdlc_rx_buffer[DB_BUFFER_MAX_BYTES * 2];  ///< Buffer where message received on UART is stored
-    uint8_t                      hdlc_tx_buffer[DB_BUFFER_MAX_BYTES * 2];  ///< Internal buffer used for sending serial HDLC frames
-    uint32_t                     buttons;                                  ///< Buttons state (one byte per button)
-    uint8_t                      radio_tx_buffer[DB_BUFFER_MAX_BYTES];     ///< Internal buffer that contains the command to send (from buttons)
-    gateway_radio_packet_queue_t radio_queue;                              ///< Queue used to process received radio packets outside of interrupt
-    gateway_uart_queue_t         uart_queue;                               ///< Queue used to process received UART bytes outside of interrupt
-    bool                         handshake_done;                           ///< Whether startup handshake is done
+    uint8_t            hdlc_rx_buffer[DB_BUFFER_MAX_BYTES + DB_HDLC_FCS_LENGTH];  ///< Buffer where frames received on UART are decoded
+    uint8_t            hdlc_tx_buffer[DB_HDLC_TX_MAX_BYTES];                      ///< Internal buffer used for sending serial HDLC frames
+    volatile uint32_t  events;                                                    ///< Mask of events to process in the main loop
+    bool               radio_pending;                                             ///< Whether radio packets are waiting for room in the UART TX ring
+    bool               snapshot_pending;                                          ///< Whether changed robots are waiting for room in the UART TX ring
+    bool               drops_pending;                                             ///< Whether the downlink drop counters are waiting for room in the UART TX ring
+    gateway_radio_rx_t radio_rx;                                                  ///< Received packet and its metadata, as pushed in the radio queue
+    uint8_t            radio_tx_buffer[DB_BUFFER_MAX_BYTES];                      ///< Internal buffer that contains the packet to send over the radio
+    uint8_t            radio_queue_buffer[DB_RADIO_QUEUE_SIZE];                   ///< Storage of the radio queue
+    db_ring_t          radio_queue;                                               ///< Queue used to process received radio packets outside of interrupt
+    uint8_t            uart_queue_buffer[DB_UART_QUEUE_SIZE];                     ///< Storage of the UART queue
+    db_ring_t          uart_queue;                                                ///< Queue used to process received UART bytes outside of interrupt
+    uint8_t            snapshot_buffer[DB_SNAPSHOT_MAX_BYTES];                    ///< Buffer where the robots snapshot is written
+    bool               handshake_done;                                            ///< Whether startup handshake is done
 } gateway_vars_t;
 
 //=========================== variables ========================================
@@ -74,28 +102,62 @@ static const gpio_t _btn4   = { .port = 0, .pin = 25 };
 
 static gateway_vars_t _gw_vars;
 
+DB_PROFILE_PROBE(_hdlc_encode_probe, DB_PROFILE_ID_HDLC_ENCODE);
+DB_PROFILE_PROBE(_radio_forward_probe, DB_PROFILE_ID_RADIO_FORWARD);
+
+//=========================== prototypes =======================================
+
+static void     _post_event(uint32_t event);
+static uint32_t _take_events(void);
+static void     _handle_buttons(void);
+static void     _forward_radio_packets(void);
+static void     _forward_uart_bytes(void);
+static void     _send_snapshots(void);
+static void     _send_downlink(void);
+static void     _send_downlink_drops(void);
+static void     _send_profile(bool reset);
+
 //=========================== callbacks ========================================
 
-static void uart_callback(uint8_t data) {
+static void uart_callback(const uint8_t *data, size_t length) {
     if (!_gw_vars.handshake_done) {
+        // the version byte may arrive anywhere in the chunk, the handshake is only done once
+        // the reply is queued, otherwise the next attempt from the host retries it
         uint8_t version = DB_FIRMWARE_VERSION;
-        db_uart_write(&version, 1);
-        if (data == version) {
+        bool    replied = db_uart_write_async(&version, 1);
+        if (replied && memchr(data, version, length) != NULL) {
             _gw_vars.handshake_done = true;
         }
         return;
     }
-    _gw_vars.uart_queue.buffer[_gw_vars.uart_queue.last] = data;
-    _gw_vars.uart_queue.last                             = (_gw_vars.uart_queue.last + 1) & (DB_UART_QUEUE_SIZE - 1);
+    db_ring_write(&_gw_vars.uart_queue, data, length);
+    _post_event(DB_GATEWAY_EVENT_UART_RX);
 }
 
 static void radio_callback(uint8_t *packet, uint8_t length) {
     if (!_gw_vars.handshake_done) {
         return;
     }
-    memcpy(_gw_vars.radio_queue.packets[_gw_vars.radio_queue.last].buffer, packet, length);
-    _gw_vars.radio_queue.packets[_gw_vars.radio_queue.last].length = length;
-    _gw_vars.radio_queue.last                                      = (_gw_vars.radio_queue.last + 1) & (DB_RADIO_QUEUE_SIZE - 1);
+    _gw_vars.radio_rx.ticks                 = db_timer_ticks64();
+    _gw_vars.radio_rx.envelope.timestamp_us = db_timer_hf_now();
+    _gw_vars.radio_rx.envelope.rssi         = db_radio_rssi();
+    memcpy(_gw_vars.radio_rx.packet, packet, length);
+    db_ring_push(&_gw_vars.radio_queue, (uint8_t *)&_gw_vars.radio_rx, offsetof(gateway_radio_rx_t, packet) + length);
+    DB_PROFILE_MARK(_radio_forward_probe);
+    _post_event(DB_GATEWAY_EVENT_RADIO_RX);
+}
+
+static void buttons_callback(void *ctx) {
+    (void)ctx;
+    _post_event(DB_GATEWAY_EVENT_BUTTONS);
+}
+
+static void buttons_timer_callback(void) {
+    _post_event(DB_GATEWAY_EVENT_BUTTONS);
+}
+
+static void snapshot_timer_callback(void) {
+    _post_event(DB_GATEWAY_EVENT_SNAPSHOT);
 }
 
 //=========================== main =============================================
@@ -104,82 +166,240 @@ static void radio_callback(uint8_t *packet, uint8_t length) {
  *  @brief The program starts executing here.
  */
 int main(void) {
+    DB_PROFILE_INIT();
     db_board_init();
+    db_timer_init();
+    db_timer_hf_init();
 
     // Configure Radio as transmitter
     db_radio_init(&radio_callback, DB_RADIO_BLE_1MBit);  // All RX packets received are forwarded in an HDLC frame over UART
     db_radio_set_frequency(8);                           // Set the radio frequency to 2408 MHz.
     // Initialize the gateway context
-    _gw_vars.buttons             = 0x0000;
-    _gw_vars.radio_queue.current = 0;
-    _gw_vars.radio_queue.last    = 0;
-    _gw_vars.handshake_done      = false;
+    _gw_vars.events           = 0;
+    _gw_vars.radio_pending    = false;
+    _gw_vars.snapshot_pending = false;
+    _gw_vars.drops_pending    = false;
+    _gw_vars.handshake_done   = false;
+    robots_init();
+    downlink_init();
+    db_ring_init(&_gw_vars.radio_queue, _gw_vars.radio_queue_buffer, DB_RADIO_QUEUE_SIZE);
+    db_ring_init(&_gw_vars.uart_queue, _gw_vars.uart_queue_buffer, DB_UART_QUEUE_SIZE);
+    db_hdlc_rx_set_buffer(_gw_vars.hdlc_rx_buffer, sizeof(_gw_vars.hdlc_rx_buffer));
     db_uart_init(&_rx_pin, &_tx_pin, DB_UART_BAUDRATE, &uart_callback);
 
     db_radio_rx_enable();
 
-    db_gpio_init(&_btn2, DB_GPIO_IN_PU);
-    db_gpio_init(&_btn3, DB_GPIO_IN_PU);
-    db_gpio_init(&_btn4, DB_GPIO_IN_PU);
-    db_gpio_init(&_btn1, DB_GPIO_IN_PU);
+    // Buttons are active low, any press or release wakes up the main loop
+    db_gpio_init_irq(&_btn1, DB_GPIO_IN_PU, DB_GPIO_IRQ_EDGE_BOTH, &buttons_callback, NULL);
+    db_gpio_init_irq(&_btn2, DB_GPIO_IN_PU, DB_GPIO_IRQ_EDGE_BOTH, &buttons_callback, NULL);
+    db_gpio_init_irq(&_btn3, DB_GPIO_IN_PU, DB_GPIO_IRQ_EDGE_BOTH, &buttons_callback, NULL);
+    db_gpio_init_irq(&_btn4, DB_GPIO_IN_PU, DB_GPIO_IRQ_EDGE_BOTH, &buttons_callback, NULL);
+
+    if (DB_GATEWAY_COALESCING) {
+        db_timer_set_periodic_ms(DB_SNAPSHOT_TIMER_CHANNEL, DB_SNAPSHOT_PERIOD_MS, &snapshot_timer_callback);
+    }
 
     while (1) {
-        protocol_move_raw_command_t command;
-        // Read Button 1 (P0.11)
-        if (!db_gpio_read(&_btn1)) {
-            command.left_y = 100;
-        } else if (!db_gpio_read(&_btn2)) {
-            command.left_y = -100;
-        } else {
-            command.left_y = 0;
+        __WFE();
+
+        uint32_t events = _take_events();
+
+        if (events & DB_GATEWAY_EVENT_BUTTONS) {
+            _handle_buttons();
         }
 
-        // Read Button 2 (P0.12)
-        if (!db_gpio_read(&_btn3)) {
-            command.right_y = 100;
-        } else if (!db_gpio_read(&_btn4)) {
-            command.right_y = -100;
-        } else {
-            command.right_y = 0;
+        // Packets left over because the UART TX ring was full are retried on each wake up
+        if ((events & DB_GATEWAY_EVENT_RADIO_RX) || _gw_vars.radio_pending) {
+            _forward_radio_packets();
         }
 
-        if (command.left_y != 0 || command.right_y != 0) {
-            db_protocol_cmd_move_raw_to_buffer(_gw_vars.radio_tx_buffer, DB_BROADCAST_ADDRESS, DotBot, &command);
-            db_radio_rx_disable();
-            db_radio_tx(_gw_vars.radio_tx_buffer, sizeof(protocol_header_t) + sizeof(protocol_move_raw_command_t));
-            db_radio_rx_enable();
+        if (events & DB_GATEWAY_EVENT_UART_RX) {
+            _forward_uart_bytes();
         }
 
-        while (_gw_vars.radio_queue.current != _gw_vars.radio_queue.last) {
-            size_t frame_len = db_hdlc_encode(_gw_vars.radio_queue.packets[_gw_vars.radio_queue.current].buffer, _gw_vars.radio_queue.packets[_gw_vars.radio_queue.current].length, _gw_vars.hdlc_tx_buffer);
-            db_uart_write(_gw_vars.hdlc_tx_buffer, frame_len);
-            _gw_vars.radio_queue.current = (_gw_vars.radio_queue.current + 1) & (DB_RADIO_QUEUE_SIZE - 1);
+        // Host packets dropped by the downlink scheduler are reported so the host can react
+        if ((events & DB_GATEWAY_EVENT_UART_RX) || _gw_vars.drops_pending) {
+            _send_downlink_drops();
         }
 
-        while (_gw_vars.uart_queue.current != _gw_vars.uart_queue.last) {
-            _gw_vars.hdlc_state = db_hdlc_rx_byte(_gw_vars.uart_queue.buffer[_gw_vars.uart_queue.current]);
-            switch ((uint8_t)_gw_vars.hdlc_state) {
-                case DB_HDLC_STATE_IDLE:
-                case DB_HDLC_STATE_RECEIVING:
-                case DB_HDLC_STATE_ERROR:
-                    break;
-                case DB_HDLC_STATE_READY:
-                {
-                    size_t msg_len = db_hdlc_decode(_gw_vars.hdlc_rx_buffer);
-                    if (msg_len) {
-                        _gw_vars.hdlc_state = DB_HDLC_STATE_IDLE;
-                        db_radio_rx_disable();
-                        db_radio_tx(_gw_vars.hdlc_rx_buffer, msg_len);
-                        db_radio_rx_enable();
-                    }
-                } break;
-                default:
-                    break;
-            }
-            _gw_vars.uart_queue.current = (_gw_vars.uart_queue.current + 1) & (DB_UART_QUEUE_SIZE - 1);
+        if ((events & DB_GATEWAY_EVENT_SNAPSHOT) || _gw_vars.snapshot_pending) {
+            _send_snapshots();
+        }
+
+        if (!downlink_is_empty()) {
+            _send_downlink();
         }
     }
 
     // one last instruction, doesn't do anything, it's just to have a place to put a breakpoint.
     __NOP();
 }
+
+//=========================== private ==========================================
+
+static void _post_event(uint32_t event) {
+    // The radio and UART interrupts have different priorities, protect the read-modify-write
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    _gw_vars.events |= event;
+    __set_PRIMASK(primask);
+}
+
+static uint32_t _take_events(void) {
+    __disable_irq();
+    uint32_t events = _gw_vars.events;
+    _gw_vars.events = 0;
+    __enable_irq();
+    return events;
+}
+
+static void _handle_buttons(void) {
+    protocol_move_raw_command_t command = { 0 };
+    // Left side is controlled by buttons 1 and 2
+    if (!db_gpio_read(&_btn1)) {
+        command.left_y = DB_BUTTONS_MOVE_SPEED;
+    } else if (!db_gpio_read(&_btn2)) {
+        command.left_y = -DB_BUTTONS_MOVE_SPEED;
+    }
+
+    // Right side is controlled by buttons 3 and 4
+    if (!db_gpio_read(&_btn3)) {
+        command.right_y = DB_BUTTONS_MOVE_SPEED;
+    } else if (!db_gpio_read(&_btn4)) {
+        command.right_y = -DB_BUTTONS_MOVE_SPEED;
+    }
+
+    if (command.left_y == 0 && command.right_y == 0) {
+        // All buttons released, stop repeating the command
+        return;
+    }
+
+    db_protocol_cmd_move_raw_to_buffer(_gw_vars.radio_tx_buffer, DB_BROADCAST_ADDRESS, DotBot, &command);
+    downlink_push(_gw_vars.radio_tx_buffer, sizeof(protocol_header_t) + sizeof(protocol_move_raw_command_t), db_timer_ticks64());
+
+    // Repeat the command as long as buttons are pressed
+    db_timer_set_oneshot_ms(DB_BUTTONS_TIMER_CHANNEL, DB_BUTTONS_REPEAT_MS, &buttons_timer_callback);
+}
+
+static void _forward_radio_packets(void) {
+    _gw_vars.radio_pending = false;
+    const uint8_t *record;
+    size_t         length;
+    while ((length = db_ring_peek(&_gw_vars.radio_queue, &record)) != 0) {
+        const gateway_radio_rx_t *rx         = (const gateway_radio_rx_t *)record;
+        size_t                    packet_len = length - offsetof(gateway_radio_rx_t, packet);
+        // Keep the robots table up to date, the packet is sent with the next snapshot in coalescing mode
+        if (robots_update(rx->packet, packet_len, rx->envelope.rssi, rx->ticks) && DB_GATEWAY_COALESCING) {
+            db_ring_pop(&_gw_vars.radio_queue);
+            continue;
+        }
+        // The envelope is stored right before the packet, both are sent in the same frame
+        DB_PROFILE_BEGIN(_hdlc_encode_probe);
+        size_t frame_len = db_hdlc_encode((const uint8_t *)&rx->envelope, sizeof(protocol_gateway_envelope_t) + packet_len, _gw_vars.hdlc_tx_buffer);
+        DB_PROFILE_END(_hdlc_encode_probe);
+        if (!db_uart_write_async(_gw_vars.hdlc_tx_buffer, frame_len)) {
+            // UART TX ring is full, retry on next wake up
+            _gw_vars.radio_pending = true;
+            break;
+        }
+        db_ring_pop(&_gw_vars.radio_queue);
+        DB_PROFILE_LATENCY(_radio_forward_probe);
+    }
+}
+
+static void _forward_uart_bytes(void) {
+    const uint8_t *data;
+    size_t         length;
+    // Decode the contiguous bytes available in the queue in one go
+    while ((length = db_ring_read_span(&_gw_vars.uart_queue, &data)) != 0) {
+        size_t consumed = 0;
+        if (db_hdlc_rx_chunk(data, length, &consumed) == DB_HDLC_STATE_READY) {
+            const protocol_header_t *header         = (const protocol_header_t *)_gw_vars.hdlc_rx_buffer;
+            size_t                   payload_length = db_hdlc_rx_payload_length();
+            if (payload_length >= sizeof(protocol_header_t) + sizeof(protocol_profile_request_t) && header->dst == DB_GATEWAY_ADDRESS && header->type == DB_PROTOCOL_PROFILE_REQ) {
+                // Profiling requests addressed to the gateway are answered directly
+                const protocol_profile_request_t *request = (const protocol_profile_request_t *)&_gw_vars.hdlc_rx_buffer[sizeof(protocol_header_t)];
+                _send_profile(request->reset);
+            } else {
+                // Packets from the host are scheduled, never sent inline
+                downlink_push(_gw_vars.hdlc_rx_buffer, payload_length, db_timer_ticks64());
+            }
+        }
+        db_ring_consume(&_gw_vars.uart_queue, consumed);
+    }
+}
+
+static void _send_snapshots(void) {
+    _gw_vars.snapshot_pending = false;
+    // A snapshot is only built when its frame fits in the UART TX ring, so changes are never lost
+    while (db_uart_tx_free() >= DB_HDLC_TX_MAX_BYTES) {
+        protocol_gateway_envelope_t envelope = { .timestamp_us = db_timer_hf_now(), .rssi = 0 };
+        size_t                      length   = robots_snapshot(&_gw_vars.snapshot_buffer[sizeof(envelope)], DB_SNAPSHOT_MAX_BYTES - sizeof(envelope), db_timer_ticks64());
+        if (length == 0) {
+            return;
+        }
+        memcpy(_gw_vars.snapshot_buffer, &envelope, sizeof(envelope));
+        size_t frame_len = db_hdlc_encode(_gw_vars.snapshot_buffer, sizeof(envelope) + length, _gw_vars.hdlc_tx_buffer);
+        db_uart_write_async(_gw_vars.hdlc_tx_buffer, frame_len);
+    }
+    // UART TX ring is full, retry on next wake up
+    _gw_vars.snapshot_pending = true;
+}
+
+static void _send_downlink(void) {
+    size_t                   length = downlink_pop(_gw_vars.radio_tx_buffer, db_timer_ticks64());
+    const protocol_header_t *header = (const protocol_header_t *)_gw_vars.radio_tx_buffer;
+    if (length >= sizeof(protocol_header_t) + sizeof(protocol_echo_t) && header->type == DB_PROTOCOL_ECHO_REQUEST) {
+        // Stamp echo requests right before sending, robots reflect the timestamp in their reply
+        uint32_t timestamp_us = db_timer_hf_now();
+        memcpy(&_gw_vars.radio_tx_buffer[sizeof(protocol_header_t) + offsetof(protocol_echo_t, tx_timestamp_us)], &timestamp_us, sizeof(timestamp_us));
+    }
+
+    if (length != 0) {
+        db_radio_send(_gw_vars.radio_tx_buffer, length);
+    }
+
+    if (!downlink_is_empty()) {
+        // Send one packet per loop iteration so host frames received meanwhile are scheduled
+        // before the next one, wake up right away for the remaining packets
+        __SEV();
+    }
+}
+
+static void _send_downlink_drops(void) {
+    // The counters are cumulative, the report is only built when its frame fits in the UART TX ring
+    _gw_vars.drops_pending = db_uart_tx_free() < DB_HDLC_TX_MAX_BYTES;
+    uint32_t counters[DOWNLINK_CLASS_COUNT];
+    if (_gw_vars.drops_pending || !downlink_get_drops(counters)) {
+        return;
+    }
+
+    protocol_gateway_envelope_t envelope = { .timestamp_us = db_timer_hf_now(), .rssi = 0 };
+    protocol_downlink_drops_t   drops;
+    drops.safety  = counters[DOWNLINK_CLASS_SAFETY];
+    drops.control = counters[DOWNLINK_CLASS_CONTROL];
+    drops.bulk    = counters[DOWNLINK_CLASS_BULK];
+    size_t offset = sizeof(envelope) + sizeof(protocol_header_t);
+    memcpy(_gw_vars.snapshot_buffer, &envelope, sizeof(envelope));
+    db_protocol_header_to_buffer(&_gw_vars.snapshot_buffer[sizeof(envelope)], DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_DOWNLINK_DROPS);
+    memcpy(&_gw_vars.snapshot_buffer[offset], &drops, sizeof(drops));
+    size_t frame_len = db_hdlc_encode(_gw_vars.snapshot_buffer, offset + sizeof(drops), _gw_vars.hdlc_tx_buffer);
+    db_uart_write_async(_gw_vars.hdlc_tx_buffer, frame_len);
+}
+
+static void _send_profile(bool reset) {
+    // The snapshot buffer is free outside of _send_snapshots, the results may not fit in a single frame
+    uint8_t index  = 0;
+    size_t  offset = sizeof(protocol_gateway_envelope_t) + sizeof(protocol_header_t);
+    size_t  length;
+    while (db_uart_tx_free() >= DB_HDLC_TX_MAX_BYTES && (length = db_profile_report(&_gw_vars.snapshot_buffer[offset], DB_SNAPSHOT_MAX_BYTES - offset, &index)) != 0) {
+        protocol_gateway_envelope_t envelope = { .timestamp_us = db_timer_hf_now(), .rssi = 0 };
+        memcpy(_gw_vars.snapshot_buffer, &envelope, sizeof(envelope));
+        db_protocol_header_to_buffer(&_gw_vars.snapshot_buffer[sizeof(envelope)], DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_PROFILE_DATA);
+        size_t frame_len = db_hdlc_encode(_gw_vars.snapshot_buffer, offset + length, _gw_vars.hdlc_tx_buffer);
+        db_uart_write_async(_gw_vars.hdlc_tx_buffer, frame_len);
+    }
+    if (reset) {
+        db_profile_reset();
+    }
+}
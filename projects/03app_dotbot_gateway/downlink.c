@@ -0,0 +1,224 @@
+/**
+ * @file downlink.c
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ * @brief Scheduler of the packets sent by the gateway to the robots.
+ *
+ * @copyright Inria, 2023
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "downlink.h"
+#include "protocol.h"
+
+//=========================== defines ==========================================
+
+#define DOWNLINK_DEADLINE_TICKS ((DOWNLINK_MOVE_DEADLINE_MS * 32768UL) / 1000)  ///< Move deadline in timer ticks (32768Hz)
+
+typedef struct {
+    bool             used;                             ///< Whether the slot contains a pending packet
+    bool             move;                             ///< Whether the packet is a move command (or a stop)
+    downlink_class_t priority;                         ///< Priority class of the packet
+    uint64_t         dst;                              ///< Destination address of the packet
+    uint32_t         seq;                              ///< Sequence number, gives the order of arrival
+    uint64_t         timestamp;                        ///< Timer ticks when the packet was queued
+    uint8_t          length;                           ///< Length of the packet
+    uint8_t          data[DOWNLINK_PACKET_MAX_BYTES];  ///< Content of the packet
+} downlink_slot_t;
+
+typedef struct {
+    downlink_slot_t slots[DOWNLINK_SLOTS];           ///< Pending packets
+    uint64_t        last_dst[DOWNLINK_CLASS_COUNT];  ///< Last destination served in each class
+    uint32_t        seq;                             ///< Sequence number of the next queued packet
+    uint32_t        drops[DOWNLINK_CLASS_COUNT];     ///< Number of packets dropped because the queue was full, per class
+    bool            drops_changed;                   ///< Whether a packet was dropped since the last call to downlink_get_drops
+} downlink_vars_t;
+
+//=========================== variables ========================================
+
+static downlink_vars_t _downlink_vars;
+
+//=========================== prototypes =======================================
+
+static downlink_class_t _downlink_classify(const uint8_t *packet, size_t length, bool *move);
+static void             _downlink_flush_moves(uint64_t dst, bool stop);
+static downlink_slot_t *_downlink_get_slot(downlink_class_t priority);
+static downlink_slot_t *_downlink_select(downlink_class_t priority);
+static bool             _downlink_slot_before(const downlink_slot_t *slot, const downlink_slot_t *other);
+
+//=========================== public ===========================================
+
+void downlink_init(void) {
+    memset(&_downlink_vars, 0, sizeof(_downlink_vars));
+}
+
+bool downlink_push(const uint8_t *packet, size_t length, uint64_t now) {
+    if (length == 0 || length > DOWNLINK_PACKET_MAX_BYTES) {
+        return false;
+    }
+
+    bool             move     = false;
+    downlink_class_t priority = _downlink_classify(packet, length, &move);
+    uint64_t         dst      = DB_BROADCAST_ADDRESS;
+    if (length >= sizeof(protocol_header_t)) {
+        dst = ((const protocol_header_t *)packet)->dst;
+    }
+
+    if (move) {
+        // Only the latest move command matters, a stop also cancels the pending moves
+        _downlink_flush_moves(dst, priority == DOWNLINK_CLASS_SAFETY);
+    }
+
+    downlink_slot_t *slot = _downlink_get_slot(priority);
+    if (slot == NULL) {
+        _downlink_vars.drops[priority]++;
+        _downlink_vars.drops_changed = true;
+        return false;
+    }
+
+    slot->used      = true;
+    slot->move      = move;
+    slot->priority  = priority;
+    slot->dst       = dst;
+    slot->seq       = _downlink_vars.seq++;
+    slot->timestamp = now;
+    slot->length    = length;
+    memcpy(slot->data, packet, length);
+    return true;
+}
+
+size_t downlink_pop(uint8_t *buffer, uint64_t now) {
+    // Drop the move commands that are too old to be relevant, stops never expire
+    for (uint32_t index = 0; index < DOWNLINK_SLOTS; index++) {
+        downlink_slot_t *slot = &_downlink_vars.slots[index];
+        if (slot->used && slot->priority == DOWNLINK_CLASS_CONTROL && slot->move && now - slot->timestamp > DOWNLINK_DEADLINE_TICKS) {
+            slot->used = false;
+        }
+    }
+
+    for (uint8_t priority = 0; priority < DOWNLINK_CLASS_COUNT; priority++) {
+        downlink_slot_t *slot = _downlink_select(priority);
+        if (slot == NULL) {
+            continue;
+        }
+        memcpy(buffer, slot->data, slot->length);
+        _downlink_vars.last_dst[priority] = slot->dst;
+        slot->used                        = false;
+        return slot->length;
+    }
+    return 0;
+}
+
+bool downlink_is_empty(void) {
+    for (uint32_t index = 0; index < DOWNLINK_SLOTS; index++) {
+        if (_downlink_vars.slots[index].used) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool downlink_get_drops(uint32_t *drops) {
+    memcpy(drops, _downlink_vars.drops, sizeof(_downlink_vars.drops));
+    bool changed                 = _downlink_vars.drops_changed;
+    _downlink_vars.drops_changed = false;
+    return changed;
+}
+
+//=========================== private ==========================================
+
+static downlink_class_t _downlink_classify(const uint8_t *packet, size_t length, bool *move) {
+    if (length < sizeof(protocol_header_t)) {
+        return DOWNLINK_CLASS_BULK;
+    }
+
+    const protocol_header_t *header = (const protocol_header_t *)packet;
+    switch (header->type) {
+        case DB_PROTOCOL_CMD_MOVE_RAW:
+        {
+            *move = true;
+            // A move command with all coordinates at 0 stops the robot
+            const protocol_move_raw_command_t stop = { 0 };
+            if (length >= sizeof(protocol_header_t) + sizeof(stop) && memcmp(&packet[sizeof(protocol_header_t)], &stop, sizeof(stop)) == 0) {
+                return DOWNLINK_CLASS_SAFETY;
+            }
+            return DOWNLINK_CLASS_CONTROL;
+        }
+        case DB_PROTOCOL_CMD_RGB_LED:
+        case DB_PROTOCOL_CONTROL_MODE:
+        case DB_PROTOCOL_ECHO_REQUEST:
+            return DOWNLINK_CLASS_CONTROL;
+        default:
+            return DOWNLINK_CLASS_BULK;
+    }
+}
+
+static void _downlink_flush_moves(uint64_t dst, bool stop) {
+    for (uint32_t index = 0; index < DOWNLINK_SLOTS; index++) {
+        downlink_slot_t *slot = &_downlink_vars.slots[index];
+        if (!slot->used || !slot->move) {
+            continue;
+        }
+        if (stop) {
+            // A stop supersedes any move or stop that would reach the same robots
+            if (dst == DB_BROADCAST_ADDRESS || slot->dst == DB_BROADCAST_ADDRESS || slot->dst == dst) {
+                slot->used = false;
+            }
+        } else if (slot->priority == DOWNLINK_CLASS_CONTROL && slot->dst == dst) {
+            // A move never cancels a pending stop
+            slot->used = false;
+        }
+    }
+}
+
+static downlink_slot_t *_downlink_get_slot(downlink_class_t priority) {
+    downlink_slot_t *victim = NULL;
+    for (uint32_t index = 0; index < DOWNLINK_SLOTS; index++) {
+        downlink_slot_t *slot = &_downlink_vars.slots[index];
+        if (!slot->used) {
+            return slot;
+        }
+        // The least urgent packet is the most recent one of the lowest priority class
+        if (victim == NULL || slot->priority > victim->priority || (slot->priority == victim->priority && slot->seq > victim->seq)) {
+            victim = slot;
+        }
+    }
+
+    // A packet only replaces a packet of a lower priority class, the replaced one is dropped
+    if (victim->priority <= priority) {
+        return NULL;
+    }
+    _downlink_vars.drops[victim->priority]++;
+    _downlink_vars.drops_changed = true;
+    return victim;
+}
+
+static downlink_slot_t *_downlink_select(downlink_class_t priority) {
+    // Round robin on the destinations: take the next destination after the last one served,
+    // the oldest packet first for a given destination.
+    uint64_t         last_dst = _downlink_vars.last_dst[priority];
+    downlink_slot_t *next     = NULL;
+    downlink_slot_t *first    = NULL;
+    for (uint32_t index = 0; index < DOWNLINK_SLOTS; index++) {
+        downlink_slot_t *slot = &_downlink_vars.slots[index];
+        if (!slot->used || slot->priority != priority) {
+            continue;
+        }
+        if (slot->dst > last_dst && (next == NULL || _downlink_slot_before(slot, next))) {
+            next = slot;
+        }
+        if (first == NULL || _downlink_slot_before(slot, first)) {
+            first = slot;
+        }
+    }
+    return (next != NULL) ? next : first;
+}
+
+static bool _downlink_slot_before(const downlink_slot_t *slot, const downlink_slot_t *other) {
+    if (slot->dst != other->dst) {
+        return slot->dst < other->dst;
+    }
+    return (int32_t)(slot->seq - other->seq) < 0;
+}
@@ -0,0 +1,83 @@
+#ifndef __DOWNLINK_H
+#define __DOWNLINK_H
+
+/**
+ * @file downlink.h
+ * @addtogroup gateway
+ *
+ * @brief  Scheduler of the packets sent by the gateway to the robots.
+ *
+ * Packets are sorted in priority classes and the highest class is always sent first. Within a
+ * class, destinations are served in round robin so a large transfer to one robot doesn't delay
+ * the others. Move commands are only relevant for a short time: a newer move to the same robot
+ * replaces the pending one, stale moves are dropped and a stop flushes the pending moves.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//=========================== defines ==========================================
+
+#define DOWNLINK_SLOTS            (16U)   ///< Max number of packets waiting to be sent
+#define DOWNLINK_PACKET_MAX_BYTES (255U)  ///< Max length of a packet
+#define DOWNLINK_MOVE_DEADLINE_MS (100U)  ///< Move commands not sent after this delay are dropped
+
+typedef enum {
+    DOWNLINK_CLASS_SAFETY,   ///< Stop commands
+    DOWNLINK_CLASS_CONTROL,  ///< Move, LED, control mode commands and echo requests
+    DOWNLINK_CLASS_BULK,     ///< Waypoints and any other packet
+    DOWNLINK_CLASS_COUNT,    ///< Number of priority classes
+} downlink_class_t;
+
+//=========================== public ===========================================
+
+/**
+ * @brief   Initialize the downlink scheduler with no pending packet
+ */
+void downlink_init(void);
+
+/**
+ * @brief   Queue a packet to send
+ *
+ * When all slots are used, the packet replaces the most recent packet of the lowest priority
+ * class if that class is lower than its own, otherwise it is dropped. Both cases are counted in
+ * the drop counters.
+ *
+ * @param[in]   packet      Packet to send, starting with the protocol header
+ * @param[in]   length      Length of the packet
+ * @param[in]   now         Current timer ticks
+ *
+ * @return true if the packet was queued, false if it was dropped
+ */
+bool downlink_push(const uint8_t *packet, size_t length, uint64_t now);
+
+/**
+ * @brief   Get the next packet to send and remove it from the queue
+ *
+ * @param[out]  buffer      Buffer where the packet is copied (DOWNLINK_PACKET_MAX_BYTES long)
+ * @param[in]   now         Current timer ticks, used to drop the stale move commands
+ *
+ * @return the length of the packet, 0 if there is nothing to send
+ */
+size_t downlink_pop(uint8_t *buffer, uint64_t now);
+
+/**
+ * @brief   Whether no packet is waiting to be sent
+ */
+bool downlink_is_empty(void);
+
+/**
+ * @brief   Get the number of packets dropped because the queue was full
+ *
+ * @param[out]  drops       Counters since initialization, indexed by priority class (DOWNLINK_CLASS_COUNT long)
+ *
+ * @return true if a packet was dropped since the previous call
+ */
+bool downlink_get_drops(uint32_t *drops);
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * @file robots.c
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ * @brief Table of the robots heard by the gateway.
+ *
+ * @copyright Inria, 2023
+ *
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocol.h"
+#include "robots.h"
+
+//=========================== defines ==========================================
+
+#define ROBOTS_AGE_MAX_MS (UINT16_MAX)  ///< Ages are saturated to fit in a snapshot entry
+
+typedef struct {
+    robot_t robots[ROBOTS_MAX];  ///< Open addressing hash table, indexed by robot address
+} robots_vars_t;
+
+//=========================== variables ========================================
+
+static robots_vars_t _robots_vars;
+
+//=========================== prototypes =======================================
+
+static robot_t *_robots_get(uint64_t address);
+
+//=========================== public ===========================================
+
+void robots_init(void) {
+    memset(&_robots_vars, 0, sizeof(_robots_vars));
+}
+
+bool robots_update(const uint8_t *packet, size_t length, int8_t rssi, uint64_t timestamp) {
+    if (length < sizeof(protocol_header_t) || length > ROBOTS_DATA_MAX_BYTES) {
+        return false;
+    }
+
+    const protocol_header_t *header = (const protocol_header_t *)packet;
+    switch (header->type) {
+        case DB_PROTOCOL_ADVERTISEMENT:
+        case DB_PROTOCOL_LH2_RAW_DATA:
+        case DB_PROTOCOL_LH2_LOCATION:
+        case DB_PROTOCOL_GPS_LOCATION:
+        case DB_PROTOCOL_DOTBOT_DATA:
+        case DB_PROTOCOL_SAILBOT_DATA:
+            break;
+        default:
+            // Commands are never coalesced
+            return false;
+    }
+    if (header->src == DB_GATEWAY_ADDRESS) {
+        return false;
+    }
+
+    robot_t *robot = _robots_get(header->src);
+    if (robot == NULL) {
+        // The table is full of changes not sent yet, don't lose them
+        return false;
+    }
+    robot->last_seen = timestamp;
+    robot->rssi      = rssi;
+
+    if (header->type == DB_PROTOCOL_ADVERTISEMENT && robot->length != 0) {
+        // The robot is still alive, its latest data is unchanged
+        return true;
+    }
+    if (robot->length == length && memcmp(robot->data, packet, length) == 0) {
+        return true;
+    }
+
+    memcpy(robot->data, packet, length);
+    robot->length  = length;
+    robot->changed = true;
+    return true;
+}
+
+size_t robots_snapshot(uint8_t *buffer, size_t size, uint64_t now) {
+    size_t  length = sizeof(protocol_header_t) + 1;
+    uint8_t count  = 0;
+    for (uint32_t index = 0; index < ROBOTS_MAX && count < UINT8_MAX; index++) {
+        robot_t *robot = &_robots_vars.robots[index];
+        if (!robot->changed || length + sizeof(protocol_snapshot_entry_t) + robot->length > size) {
+            continue;
+        }
+
+        // The timer runs at 32768Hz, 1000/32768 == 125/4096
+        uint64_t                  age_ms = ((now - robot->last_seen) * 125) >> 12;
+        protocol_snapshot_entry_t entry;
+        entry.age_ms = (age_ms > ROBOTS_AGE_MAX_MS) ? ROBOTS_AGE_MAX_MS : age_ms;
+        entry.rssi   = robot->rssi;
+        entry.length = robot->length;
+        memcpy(&buffer[length], &entry, sizeof(entry));
+        length += sizeof(entry);
+        memcpy(&buffer[length], robot->data, robot->length);
+        length += robot->length;
+        robot->changed = false;
+        count++;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+    db_protocol_header_to_buffer(buffer, DB_BROADCAST_ADDRESS, DotBot, DB_PROTOCOL_SNAPSHOT);
+    buffer[sizeof(protocol_header_t)] = count;
+    return length;
+}
+
+//=========================== private ==========================================
+
+static robot_t *_robots_get(uint64_t address) {
+    // Fold the address and keep the well mixed high bits of the product
+    uint32_t hash = ((uint32_t)(address ^ (address >> 32)) * 2654435761UL) >> 16;
+    robot_t *slot = NULL;
+    for (uint32_t probe = 0; probe < ROBOTS_MAX; probe++) {
+        robot_t *robot = &_robots_vars.robots[(hash + probe) & (ROBOTS_MAX - 1)];
+        if (robot->address == address) {
+            return robot;
+        }
+        if (robot->address == 0) {
+            slot = robot;
+            break;
+        }
+        // Entries with changes not sent to the host yet are never evicted
+        if (!robot->changed && (slot == NULL || robot->last_seen < slot->last_seen)) {
+            slot = robot;
+        }
+    }
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    // Take a free entry, or the unchanged robot not heard for the longest time when the table is
+    // full. Entries are never freed so the probing sequences stay valid.
+    slot->address = address;
+    slot->changed = false;
+    slot->length  = 0;
+    return slot;
+}
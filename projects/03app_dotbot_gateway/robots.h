@@ -0,0 +1,74 @@
+#ifndef __ROBOTS_H
+#define __ROBOTS_H
+
+/**
+ * @file robots.h
+ * @addtogroup gateway
+ *
+ * @brief  Table of the robots heard by the gateway.
+ *
+ * The table keeps the latest data, last seen time and RSSI of each robot, so the gateway can
+ * send the host only the robots whose data changed.
+ *
+ * @author Alexandre Abadie <alexandre.abadie@inria.fr>
+ *
+ * @copyright Inria, 2023
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+//=========================== defines ==========================================
+
+#define ROBOTS_MAX            (128U)  ///< Max number of robots tracked (must be a power of 2)
+#define ROBOTS_DATA_MAX_BYTES (64U)   ///< Max length of a stored packet, longer packets are not tracked
+
+typedef struct {
+    uint64_t address;                      ///< Address of the robot, 0 if the entry is free
+    uint64_t last_seen;                    ///< Timer ticks when the last packet of the robot was received
+    int8_t   rssi;                         ///< RSSI of the last packet of the robot, in dBm
+    bool     changed;                      ///< Whether the data changed since the last snapshot
+    uint8_t  length;                       ///< Length of the latest data
+    uint8_t  data[ROBOTS_DATA_MAX_BYTES];  ///< Latest data packet received from the robot
+} robot_t;
+
+//=========================== public ===========================================
+
+/**
+ * @brief   Initialize an empty robots table
+ */
+void robots_init(void);
+
+/**
+ * @brief   Update the table with a packet received from a robot
+ *
+ * Only telemetry packets are tracked. An advertisement refreshes the last seen time and RSSI of
+ * a known robot but doesn't replace its latest data. When the table is full, a new robot takes
+ * the entry of the unchanged robot not heard for the longest time. Entries with changes not sent
+ * in a snapshot yet are never evicted, if no other entry is available the packet isn't tracked.
+ *
+ * @param[in]   packet      Received radio packet, starting with the protocol header
+ * @param[in]   length      Length of the packet
+ * @param[in]   rssi        RSSI of the packet, in dBm
+ * @param[in]   timestamp   Timer ticks when the packet was received
+ *
+ * @return true if the packet is tracked in the table, false if it must be forwarded as is
+ */
+bool robots_update(const uint8_t *packet, size_t length, int8_t rssi, uint64_t timestamp);
+
+/**
+ * @brief   Write a snapshot packet with the robots whose data changed
+ *
+ * Robots written in the snapshot are marked unchanged. When they don't all fit in the buffer,
+ * the remaining ones are written by the next call.
+ *
+ * @param[out]  buffer      Buffer where the snapshot packet is written
+ * @param[in]   size        Size of the buffer
+ * @param[in]   now         Current timer ticks, used to compute the age of each entry
+ *
+ * @return the length of the snapshot packet, 0 if no robot changed
+ */
+size_t robots_snapshot(uint8_t *buffer, size_t size, uint64_t now);
+
+#endif
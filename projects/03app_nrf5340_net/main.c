@@ -18,16 +18,28 @@
 
 //=========================== variables =========================================
 
-static bool             _data_received  = false;
-static ipc_event_type_t _event_received = DB_IPC_NONE;
+static bool _rng_ready = false;  ///< Whether the RNG is initialized and fills the entropy pool
+
+//=========================== prototypes ========================================
+
+static void _ipc_ack(ipc_event_type_t event, uint8_t id, uint8_t value);
+static void _entropy_fill(void);
 
 //=========================== functions =========================================
 
 void radio_callback(uint8_t *packet, uint8_t length) {
-    mutex_lock();
-    ipc_shared_data.radio.rx_pdu.length = length;
-    memcpy((void *)ipc_shared_data.radio.rx_pdu.buffer, packet, length);
-    _data_received = true;
+    // Received pdus are pushed directly from the radio interrupt, the application core processes them at its own pace
+    ipc_message_t *message = ipc_ring_reserve(&ipc_shared_data.net_to_app);
+    if (message == NULL) {
+        // The application core is late, drop the pdu
+        return;
+    }
+    message->event      = DB_IPC_RADIO_RX;
+    message->pdu.length = length;
+    message->pdu.rssi   = db_radio_rssi();
+    memcpy(message->pdu.buffer, packet, length);
+    ipc_ring_commit(&ipc_shared_data.net_to_app);
+    NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_NET_TO_APP] = 1;
 }
 
 //=========================== main ==============================================
@@ -39,101 +51,117 @@ int main(void) {
     NRF_POWER_NS->TASKS_CONSTLAT = 1;
 #endif
 
-    NRF_IPC_NS->INTENSET                       = 1 << DB_IPC_CHAN_REQ;
-    NRF_IPC_NS->SEND_CNF[DB_IPC_CHAN_ACK]      = 1 << DB_IPC_CHAN_ACK;
-    NRF_IPC_NS->SEND_CNF[DB_IPC_CHAN_RADIO_RX] = 1 << DB_IPC_CHAN_RADIO_RX;
-    NRF_IPC_NS->RECEIVE_CNF[DB_IPC_CHAN_REQ]   = 1 << DB_IPC_CHAN_REQ;
+    NRF_IPC_NS->INTENSET                            = 1 << DB_IPC_CHAN_APP_TO_NET;
+    NRF_IPC_NS->SEND_CNF[DB_IPC_CHAN_NET_TO_APP]    = 1 << DB_IPC_CHAN_NET_TO_APP;
+    NRF_IPC_NS->RECEIVE_CNF[DB_IPC_CHAN_APP_TO_NET] = 1 << DB_IPC_CHAN_APP_TO_NET;
 
     NVIC_EnableIRQ(IPC_IRQn);
     NVIC_ClearPendingIRQ(IPC_IRQn);
     NVIC_SetPriority(IPC_IRQn, 1);
 
-    mutex_lock();
-    ipc_shared_data.event                   = DB_IPC_NET_READY_ACK;
-    NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-    mutex_unlock();
+    _ipc_ack(DB_IPC_NET_READY_ACK, 0, 0);
 
     while (1) {
         __WFE();
-        if (_data_received) {
-            _data_received                               = false;
-            NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_RADIO_RX] = 1;
-            mutex_unlock();
+
+        ipc_message_t *request;
+        while ((request = ipc_ring_peek(&ipc_shared_data.app_to_net)) != NULL) {
+            uint8_t event = request->event;
+            uint8_t id    = request->id;
+            uint8_t value = 0;
+            switch (event) {
+                case DB_IPC_RADIO_INIT_REQ:
+                    db_radio_init(&radio_callback, request->mode);
+                    break;
+                case DB_IPC_RADIO_FREQ_REQ:
+                    db_radio_set_frequency(request->frequency);
+                    break;
+                case DB_IPC_RADIO_CHAN_REQ:
+                    db_radio_set_channel(request->channel);
+                    break;
+                case DB_IPC_RADIO_ADDR_REQ:
+                    db_radio_set_network_address(request->addr);
+                    break;
+                case DB_IPC_RADIO_RX_EN_REQ:
+                    db_radio_rx_enable();
+                    break;
+                case DB_IPC_RADIO_RX_DIS_REQ:
+                    db_radio_rx_disable();
+                    break;
+                case DB_IPC_RADIO_TX_REQ:
+                    db_radio_tx(request->pdu.buffer, request->pdu.length);
+                    break;
+                case DB_IPC_RADIO_TX_RX_REQ:
+                    db_radio_send(request->pdu.buffer, request->pdu.length);
+                    break;
+                case DB_IPC_RNG_INIT_REQ:
+                    // Random bytes are then produced in the background, in the entropy pool
+                    db_rng_init();
+                    NVIC_EnableIRQ(RNG_IRQn);
+                    NVIC_ClearPendingIRQ(RNG_IRQn);
+                    _rng_ready = true;
+                    break;
+                default:
+                    event = DB_IPC_NONE;
+                    break;
+            }
+            // Give the slot back before acknowledging, the application core may send the next request right away
+            ipc_ring_release(&ipc_shared_data.app_to_net);
+            if (event != DB_IPC_NONE) {
+                // Each request event is directly followed by its acknowledgment event
+                _ipc_ack(event + 1, id, value);
+            }
         }
-        switch (_event_received) {
-            case DB_IPC_RADIO_INIT_REQ:
-                mutex_lock();
-                db_radio_init(&radio_callback, ipc_shared_data.radio.mode);
-                ipc_shared_data.event                   = DB_IPC_RADIO_INIT_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_FREQ_REQ:
-                mutex_lock();
-                db_radio_set_frequency(ipc_shared_data.radio.frequency);
-                ipc_shared_data.event                   = DB_IPC_RADIO_FREQ_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_CHAN_REQ:
-                mutex_lock();
-                db_radio_set_channel(ipc_shared_data.radio.channel);
-                ipc_shared_data.event                   = DB_IPC_RADIO_CHAN_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_ADDR_REQ:
-                mutex_lock();
-                db_radio_set_network_address(ipc_shared_data.radio.addr);
-                ipc_shared_data.event                   = DB_IPC_RADIO_ADDR_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_RX_EN_REQ:
-                mutex_lock();
-                db_radio_rx_enable();
-                ipc_shared_data.event                   = DB_IPC_RADIO_RX_EN_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_RX_DIS_REQ:
-                mutex_lock();
-                db_radio_rx_disable();
-                ipc_shared_data.event                   = DB_IPC_RADIO_RX_DIS_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RADIO_TX_REQ:
-                mutex_lock();
-                db_radio_tx((uint8_t *)ipc_shared_data.radio.tx_pdu.buffer, ipc_shared_data.radio.tx_pdu.length);
-                ipc_shared_data.event                   = DB_IPC_RADIO_TX_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RNG_INIT_REQ:
-                mutex_lock();
-                db_rng_init();
-                ipc_shared_data.event                   = DB_IPC_RNG_INIT_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            case DB_IPC_RNG_READ_REQ:
-                mutex_lock();
-                db_rng_read((uint8_t *)&ipc_shared_data.rng.value);
-                ipc_shared_data.event                   = DB_IPC_RNG_READ_ACK;
-                NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_ACK] = 1;
-                mutex_unlock();
-                break;
-            default:
-                break;
+
+        // The application core rings the doorbell after reading from the entropy pool
+        if (_rng_ready) {
+            _entropy_fill();
         }
-        _event_received = DB_IPC_NONE;
     };
 }
 
+//=========================== private ===========================================
+
+static void _ipc_ack(ipc_event_type_t event, uint8_t id, uint8_t value) {
+    ipc_message_t *message;
+    // The radio interrupt also writes to the ring, keep a single producer at a time
+    __disable_irq();
+    while ((message = ipc_ring_reserve(&ipc_shared_data.net_to_app)) == NULL) {}
+    message->event = event;
+    message->id    = id;
+    message->value = value;
+    ipc_ring_commit(&ipc_shared_data.net_to_app);
+    __enable_irq();
+    NRF_IPC_NS->TASKS_SEND[DB_IPC_CHAN_NET_TO_APP] = 1;
+}
+
+static void _entropy_fill(void) {
+    ipc_entropy_t *pool = (ipc_entropy_t *)&ipc_shared_data.entropy;
+    if (pool->head - __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE) < IPC_ENTROPY_SIZE) {
+        // The RNG stops by itself after each value (VALRDY_STOP short), the interrupt restarts it
+        NRF_RNG_NS->TASKS_START = 1;
+    }
+}
+
+//=========================== interrupt handlers ================================
+
 void IPC_IRQHandler(void) {
-    if (NRF_IPC_NS->EVENTS_RECEIVE[DB_IPC_CHAN_REQ]) {
-        NRF_IPC_NS->EVENTS_RECEIVE[DB_IPC_CHAN_REQ] = 0;
-        _event_received                             = ipc_shared_data.event;
+    // The IPC is only a doorbell, requests are read from the ring in the main loop
+    if (NRF_IPC_NS->EVENTS_RECEIVE[DB_IPC_CHAN_APP_TO_NET]) {
+        NRF_IPC_NS->EVENTS_RECEIVE[DB_IPC_CHAN_APP_TO_NET] = 0;
+    }
+}
+
+void RNG_IRQHandler(void) {
+    if (NRF_RNG_NS->EVENTS_VALRDY) {
+        NRF_RNG_NS->EVENTS_VALRDY = 0;
+
+        ipc_entropy_t *pool = (ipc_entropy_t *)&ipc_shared_data.entropy;
+        uint32_t       head = pool->head;
+        if (head - __atomic_load_n(&pool->tail, __ATOMIC_ACQUIRE) < IPC_ENTROPY_SIZE) {
+            pool->bytes[head & (IPC_ENTROPY_SIZE - 1)] = (uint8_t)NRF_RNG_NS->VALUE;
+            __atomic_store_n(&pool->head, head + 1, __ATOMIC_RELEASE);
+        }
+        _entropy_fill();
     }
 }
@@ -18,11 +18,14 @@
 
 // Include BSP packages
 #include "device.h"
+#include "fixmath.h"
 #include "radio.h"
 #include "servos.h"
 #include "gps.h"
 #include "lis2mdl.h"
+#include "log.h"
 #include "protocol.h"
+#include "scheduler.h"
 #include "timer.h"
 #include "timer_hf.h"
 #include "gpio.h"
@@ -35,7 +38,7 @@
 #define WAYPOINT_DISTANCE_THRESHOLD (10)    ///< in meters
 
 #define SAIL_TRIM_ANGLE_UNIT_STEP (10)     //< unit step increase/decrease when trimming the sails
-#define TIMEOUT_CHECK_DELAY_TICKS (17000)  ///< ~500 ms delay between packet received timeout checks
+#define TIMEOUT_CHECK_DELAY_TICKS (17000)  ///< ~519 ms (32768 Hz RTC ticks) delay between packet received timeout checks
 #define TIMEOUT_CHECK_DELAY_MS    (200)    ///< 200 ms delay between packet received timeout checks
 #define ADVERTISEMENT_PERIOD_MS   (500)    ///< send an advertisement every 500 ms
 #define DB_BUFFER_MAX_BYTES       (64U)    ///< Max bytes in UART receive buffer
@@ -58,13 +61,19 @@
 #define CONST_ORIGIN_COORD_SYSTEM_LONG CONST_METRO_LIBERTE_LONG
 #define CONST_COS_PHI_0                CONST_COS_PHI_0_INRIA_PARIS
 
+// constants of the local coordinate system, evaluated at compile time
+#define CONST_ORIGIN_LAT_UDEG  ((int32_t)(CONST_ORIGIN_COORD_SYSTEM_LAT * 1e6))                      // latitude of the origin, in micro degrees
+#define CONST_ORIGIN_LONG_UDEG ((int32_t)(CONST_ORIGIN_COORD_SYSTEM_LONG * 1e6))                     // longitude of the origin, in micro degrees
+#define CONST_MM_PER_UDEG_LAT  DB_FIXMATH_Q16(CONST_EARTH_RADIUS_KM * M_PI / 180)                    // R * PI / 180 (km to mm, micro degrees to degrees), Q16.16
+#define CONST_MM_PER_UDEG_LONG DB_FIXMATH_Q16(CONST_EARTH_RADIUS_KM * M_PI / 180 * CONST_COS_PHI_0)  // R * PI / 180 * cos(PHI_0), Q16.16
+
 typedef struct {
-    float x;
-    float y;
+    int32_t x;  ///< East, in millimeters
+    int32_t y;  ///< North, in millimeters
 } cartesian_coordinate_t;
 
 typedef struct {
-    uint32_t                 ts_last_packet_received;            ///< Last timestamp in microseconds a control packet was received
+    volatile uint64_t        ts_last_packet_received;            ///< Last timestamp in ticks a control packet was received (written from the radio interrupt)
     int8_t                   sail_trim;                          ///< Last angle of the servo controlling sail trim
     protocol_gps_waypoints_t waypoints;                          ///< List of waypoints
     uint32_t                 waypoints_threshold;                ///< Distance threshold to next waypoint
@@ -72,6 +81,14 @@ typedef struct {
     uint8_t                  radio_buffer[DB_BUFFER_MAX_BYTES];  ///< Internal buffer that contains the command to send (from buttons)
     bool                     autonomous_operation;               ///< Flag used to enable/disable autonomous operation
     bool                     radio_override;                     ///< Flag used to override autonomous operation when radio-controlled
+    protocol_echo_t          echo;                               ///< Last echo request received
+    uint64_t                 echo_dst;                           ///< Address of the sender of the last echo request
+    db_scheduler_task_t      control_task;                       ///< Runs the control loop
+    db_scheduler_task_t      timeout_task;                       ///< Resets the servos when no control packet is received
+    db_scheduler_task_t      advertise_task;                     ///< Sends an advertisement packet
+    db_scheduler_task_t      echo_task;                          ///< Sends the echo reply
+    db_scheduler_task_t      mag_cal_task;                       ///< Starts or stops the magnetometer calibration
+    bool                     mag_cal_start;                      ///< Whether the last calibration request was a start
 } sailbot_vars_t;
 
 //=========================== variables =========================================
@@ -84,12 +101,16 @@ static sailbot_vars_t _sailbot_vars = { 0 };
 void          radio_callback(uint8_t *packet, uint8_t length);
 void          control_loop_callback(void);
 static void   convert_geographical_to_cartesian(cartesian_coordinate_t *out, const protocol_gps_coordinate_t *in);
-static float  _distance(const cartesian_coordinate_t *pos1, const cartesian_coordinate_t *pos2);
-static float  calculate_error(float heading, float bearing);
-static int8_t map_error_to_rudder_angle(float error);
+static int8_t map_error_to_rudder_angle(int32_t error);
 static void   _timeout_check(void);
 static void   _advertise(void);
 static void   _send_gps_data(const nmea_gprmc_t *data, uint16_t heading);
+static void   _send_echo_reply(void);
+static void   _send_logs(void);
+static void   _mag_calibration(void);
+static void   _post_control_loop(void);
+static void   _post_timeout_check(void);
+static void   _post_advertise(void);
 
 //=========================== main =========================================
 
@@ -110,7 +131,16 @@ int main(void) {
     db_radio_set_frequency(8);                           // Set the RX frequency to 2408 MHz.
     db_radio_rx_enable();                                // Start receiving packets.
 
-    // Init the IMU
+    // All the work is done from thread context, interrupts only post tasks
+    db_scheduler_init();
+    db_scheduler_task_init(&_sailbot_vars.control_task, &control_loop_callback, DB_SCHEDULER_PRIORITY_HIGH);
+    db_scheduler_task_init(&_sailbot_vars.timeout_task, &_timeout_check, DB_SCHEDULER_PRIORITY_HIGH);
+    db_scheduler_task_init(&_sailbot_vars.advertise_task, &_advertise, DB_SCHEDULER_PRIORITY_LOW);
+    db_scheduler_task_init(&_sailbot_vars.echo_task, &_send_echo_reply, DB_SCHEDULER_PRIORITY_LOW);
+    db_scheduler_task_init(&_sailbot_vars.mag_cal_task, &_mag_calibration, DB_SCHEDULER_PRIORITY_LOW);
+    db_scheduler_set_idle_handler(&_send_logs);
+
+    // Init the IMU, the heading is updated in the background each time a sample is ready
     lis2mdl_init(NULL);
 
     // Configure Motors
@@ -125,20 +155,13 @@ int main(void) {
     gps_init(NULL);
 
     // set timer callbacks
-    db_timer_set_periodic_ms(0, TIMEOUT_CHECK_DELAY_MS, &_timeout_check);
-    db_timer_set_periodic_ms(1, ADVERTISEMENT_PERIOD_MS, &_advertise);
+    db_timer_set_periodic_ms(0, TIMEOUT_CHECK_DELAY_MS, &_post_timeout_check);
+    db_timer_set_periodic_ms(1, ADVERTISEMENT_PERIOD_MS, &_post_advertise);
 
-    db_timer_hf_set_periodic_us(0, CONTROL_LOOP_PERIOD_MS * 1000, &control_loop_callback);
+    db_timer_hf_set_periodic_us(0, CONTROL_LOOP_PERIOD_MS * 1000, &_post_control_loop);
 
-    // Wait for radio packets to arrive
-    while (1) {
-        // processor idle until an interrupt occurs and is handled
-        // if IMU data is ready, trigger the I2C transfer from outside the interrupt context
-        if (lis2mdl_data_ready()) {
-            lis2mdl_read_heading();
-        }
-        __WFE();
-    }
+    // processor idle until a task is posted from an interrupt
+    db_scheduler_run();
 
     // one last instruction, doesn't do anything, it's just to have a place to put a breakpoint.
     __NOP();
@@ -161,7 +184,7 @@ void radio_callback(uint8_t *packet, uint8_t length) {
     protocol_header_t *header  = (protocol_header_t *)ptk_ptr;
 
     // timestamp the arrival of the packet
-    _sailbot_vars.ts_last_packet_received = db_timer_ticks();
+    _sailbot_vars.ts_last_packet_received = db_timer_ticks64();
 
     // Check destination address matches
     if (header->dst != DB_BROADCAST_ADDRESS && header->dst != db_device_id()) {
@@ -208,6 +231,19 @@ void radio_callback(uint8_t *packet, uint8_t length) {
                 _sailbot_vars.autonomous_operation = true;
             }
         } break;
+        case DB_PROTOCOL_ECHO_REQUEST:
+            // The reply is sent from thread context
+            memcpy(&_sailbot_vars.echo, cmd_ptr, sizeof(protocol_echo_t));
+            _sailbot_vars.echo_dst = header->src;
+            db_scheduler_post(&_sailbot_vars.echo_task);
+            break;
+        case DB_PROTOCOL_MAG_CAL_REQ:
+        {
+            // I2C accesses are done from thread context
+            const protocol_mag_cal_request_t *request = (const protocol_mag_cal_request_t *)cmd_ptr;
+            _sailbot_vars.mag_cal_start               = request->start;
+            db_scheduler_post(&_sailbot_vars.mag_cal_task);
+        } break;
         default:
             break;
     }
@@ -222,9 +258,9 @@ void control_loop_callback(void) {
     }
 
     // get heading
-    float heading = lis2mdl_last_heading();
+    int32_t heading = lis2mdl_last_heading_cdeg();
 
-    _send_gps_data(gps_data, (uint16_t)(heading * 180 / M_PI));
+    _send_gps_data(gps_data, heading / 100);
 
     if (!_sailbot_vars.autonomous_operation) {
         // Do nothing if not in autonomous operation
@@ -241,38 +277,35 @@ void control_loop_callback(void) {
     protocol_gps_coordinate_t current_position_gps = { 0, 0 };
     cartesian_coordinate_t    target               = { 0, 0 };
     cartesian_coordinate_t    position             = { 0, 0 };
-    float                     theta                = 0;
-    float                     error                = 0;
+    int32_t                   theta                = 0;
+    int32_t                   error                = 0;
     int8_t                    rudder_angle         = 0;
 
     // convert the next_waypoint to local coordinate system (and copy to stack to avoid concurrency issues)
     convert_geographical_to_cartesian(&target, &_sailbot_vars.waypoints.coordinates[_sailbot_vars.next_waypoint_idx]);
 
     // save the current GPS position on stack to avoid concurrency issues between control_loop_callback() and the GPS module
-    current_position_gps.latitude  = (int32_t)(gps_data->latitude * 1e6);
-    current_position_gps.longitude = (int32_t)(gps_data->longitude * 1e6);
+    current_position_gps.latitude  = (int32_t)(gps_data->latitude * 1e6f);
+    current_position_gps.longitude = (int32_t)(gps_data->longitude * 1e6f);
 
     // convert geographical data given by GPS to our local coordinate system
     convert_geographical_to_cartesian(&position, &current_position_gps);
 
-    float distance_to_target = _distance(&target, &position);
+    uint32_t distance_to_target = db_fixmath_distance(target.x - position.x, target.y - position.y);
 
-    // Check the next waypoint was reached, if yes increase the waypoint index and return
-    if (distance_to_target < _sailbot_vars.waypoints_threshold) {
+    // Check the next waypoint was reached (the threshold is in meters), if yes increase the waypoint index and return
+    if (distance_to_target < _sailbot_vars.waypoints_threshold * 1000) {
         _sailbot_vars.next_waypoint_idx++;
         return;
     }
 
     // calculate the angle theta, which is the angle between myself and the waypoint relative to the y axis
-    theta = atan2f(target.x - position.x, target.y - position.y);  // north clockwise convention
-    if (theta < 0) {
-        theta += M_PI * 2;
-    }
+    theta = db_fixmath_atan2_cdeg(target.x - position.x, target.y - position.y);  // north clockwise convention
 
-    // calculate the error
-    error = calculate_error(heading, theta);
+    // calculate the error, between -180 and 180 degrees
+    error = db_fixmath_wrap_180_cdeg(theta - heading);
 
-    // convert error in radians to rudder angle
+    // convert error in centidegrees to rudder angle
     rudder_angle = map_error_to_rudder_angle(error);
 
     // set the rudder servo
@@ -282,8 +315,8 @@ void control_loop_callback(void) {
 }
 
 static void _send_gps_data(const nmea_gprmc_t *data, uint16_t heading) {
-    int32_t latitude  = (int32_t)(data->latitude * 1e6);
-    int32_t longitude = (int32_t)(data->longitude * 1e6);
+    int32_t latitude  = (int32_t)(data->latitude * 1e6f);
+    int32_t longitude = (int32_t)(data->longitude * 1e6f);
 
     db_protocol_header_to_buffer(_sailbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, SailBot, DB_PROTOCOL_SAILBOT_DATA);
 
@@ -292,38 +325,75 @@ static void _send_gps_data(const nmea_gprmc_t *data, uint16_t heading) {
     memcpy(_sailbot_vars.radio_buffer + sizeof(protocol_header_t) + sizeof(uint16_t) + sizeof(int32_t), &longitude, sizeof(int32_t));
 
     size_t length = sizeof(protocol_header_t) + sizeof(uint16_t) + 2 * sizeof(int32_t);
-    db_radio_rx_disable();
-    db_radio_tx(_sailbot_vars.radio_buffer, length);
-    db_radio_rx_enable();
+    db_radio_send(_sailbot_vars.radio_buffer, length);
 }
 
-static int8_t map_error_to_rudder_angle(float error) {
-    float converted = 255.0 * error / M_PI / 2.0;
+static void _send_echo_reply(void) {
+    db_protocol_header_to_buffer(_sailbot_vars.radio_buffer, _sailbot_vars.echo_dst, SailBot, DB_PROTOCOL_ECHO_REPLY);
+    memcpy(_sailbot_vars.radio_buffer + sizeof(protocol_header_t), &_sailbot_vars.echo, sizeof(protocol_echo_t));
 
-    if (converted > 127) {
-        return 127;
+    size_t length = sizeof(protocol_header_t) + sizeof(protocol_echo_t);
+    db_radio_send(_sailbot_vars.radio_buffer, length);
+}
+
+static void _mag_calibration(void) {
+    if (_sailbot_vars.mag_cal_start) {
+        // samples are collected while the boat is rotated in all directions
+        lis2mdl_calibration_start();
+        return;
     }
-    if (converted < -128) {
-        return -128;
+
+    lis2mdl_compass_data_t  offset;
+    uint16_t                radius;
+    protocol_mag_cal_data_t result = { 0 };
+    result.valid                   = lis2mdl_calibration_stop(&offset, &radius);
+    if (result.valid) {
+        result.x      = offset.x;
+        result.y      = offset.y;
+        result.z      = offset.z;
+        result.radius = radius;
     }
-    return (int8_t)converted;
+
+    db_protocol_header_to_buffer(_sailbot_vars.radio_buffer, DB_GATEWAY_ADDRESS, SailBot, DB_PROTOCOL_MAG_CAL_DATA);
+    memcpy(_sailbot_vars.radio_buffer + sizeof(protocol_header_t), &result, sizeof(protocol_mag_cal_data_t));
+
+    size_t length = sizeof(protocol_header_t) + sizeof(protocol_mag_cal_data_t);
+    db_radio_send(_sailbot_vars.radio_buffer, length);
 }
 
-static float calculate_error(float heading, float bearing) {
-    float difference = bearing - heading;
+static void _send_logs(void) {
+    // Log records are sent to the gateway which forwards them to the host, where they are decoded
+    while (db_log_pending()) {
+        db_protocol_header_to_buffer(_sailbot_vars.radio_buffer, DB_GATEWAY_ADDRESS, SailBot, DB_PROTOCOL_LOG);
+        size_t length = db_log_read(_sailbot_vars.radio_buffer + sizeof(protocol_header_t), DB_BUFFER_MAX_BYTES - sizeof(protocol_header_t));
+        if (length == 0) {
+            break;
+        }
+        db_radio_send(_sailbot_vars.radio_buffer, sizeof(protocol_header_t) + length);
+    }
+}
+
+static int8_t map_error_to_rudder_angle(int32_t error) {
+    int32_t converted = 255 * error / DB_FIXMATH_360_CDEG;
 
-    if (difference < -M_PI) {
-        difference += 2 * M_PI;
+    if (converted > 127) {
+        return 127;
     }
-    if (difference > M_PI) {
-        difference -= 2 * M_PI;
+    if (converted < -128) {
+        return -128;
     }
-    return difference;
+    return (int8_t)converted;
 }
 
 static void _timeout_check(void) {
-    uint32_t ticks = db_timer_ticks();
-    if (ticks > _sailbot_vars.ts_last_packet_received + TIMEOUT_CHECK_DELAY_TICKS && _sailbot_vars.ts_last_packet_received > 0) {
+    // the 64 bits timestamp is written from the radio interrupt, read it at once
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t last_packet = _sailbot_vars.ts_last_packet_received;
+    __set_PRIMASK(primask);
+
+    uint64_t ticks = db_timer_ticks64();
+    if (ticks > last_packet + TIMEOUT_CHECK_DELAY_TICKS && last_packet > 0) {
         if (_sailbot_vars.autonomous_operation && _sailbot_vars.radio_override) {
             _sailbot_vars.radio_override = false;
         }
@@ -338,29 +408,28 @@ static void _timeout_check(void) {
 static void _advertise(void) {
     db_protocol_header_to_buffer(_sailbot_vars.radio_buffer, DB_BROADCAST_ADDRESS, SailBot, DB_PROTOCOL_ADVERTISEMENT);
     size_t length = sizeof(protocol_header_t);
-    db_radio_rx_disable();
-    db_radio_tx(_sailbot_vars.radio_buffer, length);
-    db_radio_rx_enable();
+    db_radio_send(_sailbot_vars.radio_buffer, length);
 }
 
-static void convert_geographical_to_cartesian(cartesian_coordinate_t *out, const protocol_gps_coordinate_t *in) {
-    assert(in->latitude <= (90 * 1e6) && in->latitude >= (-90 * 1e6));
-    assert(in->longitude <= (180 * 1e6) && in->longitude >= (-180 * 1e6));
+static void _post_control_loop(void) {
+    db_scheduler_post(&_sailbot_vars.control_task);
+}
 
-    // x = R*(longitude - longitude_at_origin) * cos(PHI_0)
-    out->x = (((float)in->longitude / 1e6) - CONST_ORIGIN_COORD_SYSTEM_LONG) * CONST_EARTH_RADIUS_KM;
-    out->x *= CONST_COS_PHI_0;
-    // account for longitude in degrees by converting to radians and then to meters (from km)
-    out->x *= M_PI;
-    out->x = out->x * 100.0 / 18.0;  // multiply by 1000, divide by 180
+static void _post_timeout_check(void) {
+    db_scheduler_post(&_sailbot_vars.timeout_task);
+}
 
-    // y = R(latitude - latitude_at_origin))
-    out->y = (((float)in->latitude / 1e6) - CONST_ORIGIN_COORD_SYSTEM_LAT) * CONST_EARTH_RADIUS_KM;
-    // account for latitude in degrees by converting to radians and then to meters (from km)
-    out->y *= M_PI;
-    out->y = out->y * 100.0 / 18.0;
+static void _post_advertise(void) {
+    db_scheduler_post(&_sailbot_vars.advertise_task);
 }
 
-static float _distance(const cartesian_coordinate_t *pos1, const cartesian_coordinate_t *pos2) {
-    return sqrtf(powf(pos2->x - pos1->x, 2) + powf(pos2->y - pos1->y, 2));  // in meters
+static void convert_geographical_to_cartesian(cartesian_coordinate_t *out, const protocol_gps_coordinate_t *in) {
+    assert(in->latitude <= 90000000 && in->latitude >= -90000000);
+    assert(in->longitude <= 180000000 && in->longitude >= -180000000);
+
+    // x = R*(longitude - longitude_at_origin) * cos(PHI_0), saturates more than 19 degrees away from the origin
+    out->x = db_fixmath_mul_q16(in->longitude - CONST_ORIGIN_LONG_UDEG, CONST_MM_PER_UDEG_LONG);
+
+    // y = R(latitude - latitude_at_origin))
+    out->y = db_fixmath_mul_q16(in->latitude - CONST_ORIGIN_LAT_UDEG, CONST_MM_PER_UDEG_LAT);
 }
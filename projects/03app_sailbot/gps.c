@@ -6,7 +6,6 @@
  * @copyright Inria, 2022
  *
  */
-#include <stdio.h>
 #include <stdlib.h>
 #include <nrf.h>
 #include <string.h>
@@ -16,6 +15,7 @@
 #include "uart.h"
 #include "gps.h"
 #include "timer.h"
+#include "log.h"
 
 //=========================== defines ==========================================
 
@@ -43,7 +43,7 @@ uint8_t  nmea_calculate_checksum(uint8_t *buffer);
 
 //=========================== callbacks ========================================
 
-static void uart_callback(uint8_t byte) {
+static void _gps_rx_byte(uint8_t byte) {
     int parsing_error;
 
     // initialize to error
@@ -75,6 +75,12 @@ static void uart_callback(uint8_t byte) {
     }
 }
 
+static void uart_callback(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        _gps_rx_byte(data[i]);
+    }
+}
+
 // from https://stackoverflow.com/questions/26522583/c-strtok-skips-second-token-or-consecutive-delimiter
 // version of strtok that handles consecutive delimeters
 uint8_t *strtok_new(uint8_t *string, uint8_t const *delimiter) {
@@ -117,7 +123,7 @@ int nmea_parse_gprmc_sentence(uint8_t *buffer, nmea_gprmc_t *position) {
     rcvd_checksum        = strtol((char *)rcvd_checksum_buf, NULL, 16);
 
     if (rcvd_checksum != calculated_checksum) {
-        printf("gps: Invalid checksum. Sentence: %s \n", buffer);
+        DB_LOG("gps: invalid checksum, received 0x%02x, computed 0x%02x", rcvd_checksum, calculated_checksum);
         position->valid = 0;
         return -1;
     }